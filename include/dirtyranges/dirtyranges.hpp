@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// Element ranges written since the last Take. Marks are appended as they come and only sorted and merged when the list
+// grows (so repeated marks of the same elements stay cheap) or when the owner takes them for an upload.
+class DirtyRanges {
+    public:
+        struct Span {
+            size_t begin;
+            size_t end; // exclusive
+        };
+
+        void Mark(size_t index) { Mark(index, index + 1); }
+
+        void Mark(size_t begin, size_t end) {
+            if (begin >= end) return;
+            if (!spans.empty() && begin <= spans.back().end && end >= spans.back().begin) { // touches the last mark
+                spans.back().begin = std::min(spans.back().begin, begin);
+                spans.back().end = std::max(spans.back().end, end);
+                return;
+            }
+            spans.push_back({begin, end});
+            if (spans.size() >= merge_at) {
+                Merge(0);
+                merge_at = std::max<size_t>(MIN_MERGE, spans.size() * 2);
+            }
+        }
+
+        // every element below count, earlier marks are covered
+        void MarkAll(size_t count) {
+            spans.clear();
+            Mark(0, count);
+        }
+
+        bool Empty(void) const { return spans.empty(); }
+
+        // Sorted, disjoint spans clipped to count (elements past it no longer exist). Spans less than gap elements apart
+        // are joined, copying a few clean elements is cheaper than another copy command.
+        std::vector<Span> Take(size_t count, size_t gap = 0) {
+            Merge(gap);
+            std::vector<Span> taken;
+            taken.swap(spans);
+            while (!taken.empty() && taken.back().begin >= count) taken.pop_back();
+            if (!taken.empty()) taken.back().end = std::min(taken.back().end, count);
+            merge_at = MIN_MERGE;
+            return taken;
+        }
+    private:
+        static constexpr size_t MIN_MERGE = 1024;
+
+        void Merge(size_t gap) {
+            std::sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) { return a.begin < b.begin; });
+            size_t out = 0;
+            for (size_t i = 0; i < spans.size(); i++) {
+                if (out > 0 && spans[i].begin <= spans[out - 1].end + gap) {
+                    spans[out - 1].end = std::max(spans[out - 1].end, spans[i].end);
+                    continue;
+                }
+                spans[out++] = spans[i];
+            }
+            spans.resize(out);
+        }
+
+        std::vector<Span> spans{};
+        size_t merge_at = MIN_MERGE;
+};
\ No newline at end of file
@@ -22,6 +22,8 @@ struct FixedStack {
         return data[position - spot];
     }
 
+    void clear() { position = 0; }
+
     bool empty() const { return position == 0; }
     size_t size() const { return position; }
 };
\ No newline at end of file
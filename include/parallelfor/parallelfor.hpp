@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Number of workers ParallelFor will use, callers size their per worker scratch with this.
+inline size_t ParallelWorkerCount(size_t count) {
+    size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(hardware, count));
+}
+
+// Runs func(index, worker) for every index in [0, count). Indices are handed out one at a time so uneven work
+// balances itself, worker is in [0, ParallelWorkerCount(count)) and is only ever used by one thread at a time.
+template<typename F>
+void ParallelFor(size_t count, F &&func) {
+    size_t workers = ParallelWorkerCount(count);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) func(i, size_t(0));
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto run = [&](size_t worker) {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed))
+            func(i, worker);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t w = 1; w < workers; w++) threads.emplace_back(run, w);
+    run(0);
+    for (std::thread &t : threads) t.join();
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+
+// First fit allocator of offsets into a linear range, the owner does the actual storage. Free ranges are kept sorted
+// by offset and joined with their neighbours when freed, so a heap of a few large, long lived allocations stays in one
+// piece.
+class RangeAllocator {
+    public:
+        static constexpr size_t INVALID = ~size_t(0);
+
+        explicit RangeAllocator(size_t alignment = 1) : alignment(alignment) {}
+
+        // offset of size free units, INVALID when no free range is large enough
+        size_t Allocate(size_t size) {
+            size = Align(size > 0 ? size : 1); // empty allocations still get an offset of their own
+            for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+                if (it->second < size) continue;
+                size_t offset = it->first;
+                size_t left = it->second - size;
+                free_ranges.erase(it);
+                if (left > 0) free_ranges[offset + size] = left;
+                allocated[offset] = size;
+                return offset;
+            }
+            return INVALID;
+        }
+
+        void Free(size_t offset) {
+            auto found = allocated.find(offset);
+            if (found == allocated.end()) return;
+            size_t size = found->second;
+            allocated.erase(found);
+            Insert(offset, size);
+        }
+
+        // the range grew to capacity units, the new tail is free
+        void Extend(size_t capacity) {
+            if (capacity <= this->capacity) return;
+            Insert(this->capacity, capacity - this->capacity);
+            this->capacity = capacity;
+        }
+
+        size_t GetCapacity(void) const { return capacity; }
+        size_t Align(size_t size) const { return (size + alignment - 1) / alignment * alignment; }
+    private:
+        void Insert(size_t offset, size_t size) {
+            auto next = free_ranges.lower_bound(offset);
+            if (next != free_ranges.end() && offset + size == next->first) {
+                size += next->second;
+                next = free_ranges.erase(next);
+            }
+            if (next != free_ranges.begin()) {
+                auto previous = std::prev(next);
+                if (previous->first + previous->second == offset) {
+                    previous->second += size;
+                    return;
+                }
+            }
+            free_ranges[offset] = size;
+        }
+
+        size_t alignment;
+        size_t capacity = 0;
+        std::map<size_t, size_t> free_ranges{}; // offset -> size
+        std::map<size_t, size_t> allocated{};
+};
\ No newline at end of file
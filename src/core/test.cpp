@@ -3,7 +3,17 @@
 #include "input.h"
 #include "console.h"
 #include "modules/voxel/voxelmanager.h"
+#include "modules/voxel/voxelcursor.h"
+#include "modules/voxel/voxelimport.h"
+#include "modules/voxel/voxelraycast.h"
 #include "stdio.h"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+#include <chrono>
+#include <random>
+#include <climits>
+#include <cmath>
 
 void Test::Print(std::string output) {
     Console &console = GetModule<Console>();
@@ -21,6 +31,192 @@ void Test::Init() {
         Print(output);
     });
 
+    // sweeps a block of the world along x with GetVoxel and with a VoxelCursor and logs both timings
+    console.CreateCommand("bench_cursor", [this](int size){
+        VoxelManager &vm = GetModule<VoxelManager>();
+        glm::ivec3 origin = vm.chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t solid_get = 0;
+        for (int z = 0; z < size; z++)
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++)
+                    solid_get += vm.GetVoxel(origin + glm::ivec3(x, y, z)).solid();
+        auto middle = std::chrono::steady_clock::now();
+
+        uint64_t solid_cursor = 0;
+        VoxelCursor cursor(vm, origin);
+        for (int z = 0; z < size; z++)
+            for (int y = 0; y < size; y++) {
+                cursor.Seek(origin + glm::ivec3(0, y, z));
+                for (int x = 0; x < size; x++) {
+                    solid_cursor += cursor.Get().solid();
+                    cursor.MoveX(1);
+                }
+            }
+        auto end = std::chrono::steady_clock::now();
+
+        double get_ms = std::chrono::duration<double, std::milli>(middle - start).count();
+        double cursor_ms = std::chrono::duration<double, std::milli>(end - middle).count();
+        Print("GetVoxel: " + std::to_string(get_ms) + "ms, VoxelCursor: " + std::to_string(cursor_ms) + "ms" + (solid_get == solid_cursor ? "" : " (MISMATCH)"));
+    });
+
+    // scattered point queries inside the world bounds: a GetVoxel loop against one GetVoxels batch
+    console.CreateCommand("bench_getvoxels", [this](int count){
+        VoxelManager &vm = GetModule<VoxelManager>();
+        glm::ivec3 origin = vm.chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+        glm::ivec3 extent = glm::ivec3(vm.chunk_occupancy.size) * glm::ivec3(CHUNK_WIDTH);
+
+        std::mt19937 rng(1234);
+        std::vector<glm::ivec3> positions(count);
+        for (glm::ivec3 &p : positions)
+            p = origin + glm::ivec3(rng() % extent.x, rng() % extent.y, rng() % extent.z);
+        std::vector<Voxel> looped(count);
+        std::vector<Voxel> batched(count);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) looped[i] = vm.GetVoxel(positions[i]);
+        auto middle = std::chrono::steady_clock::now();
+        vm.GetVoxels(positions, batched);
+        auto end = std::chrono::steady_clock::now();
+
+        double loop_ms = std::chrono::duration<double, std::milli>(middle - start).count();
+        double batch_ms = std::chrono::duration<double, std::milli>(end - middle).count();
+        Print("GetVoxel loop: " + std::to_string(loop_ms) + "ms, GetVoxels: " + std::to_string(batch_ms) + "ms" + (looped == batched ? "" : " (MISMATCH)"));
+    });
+
+    // random rays through the world: Raycast against a voxel by voxel DDA on a VoxelCursor
+    console.CreateCommand("bench_raycast", [this](int count){
+        VoxelManager &vm = GetModule<VoxelManager>();
+        glm::vec3 origin = glm::vec3(vm.chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH));
+        glm::vec3 extent = glm::vec3(vm.chunk_occupancy.size) * float(CHUNK_WIDTH);
+        const float max_distance = 512.0f;
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<glm::vec3> origins(count);
+        std::vector<glm::vec3> directions(count);
+        for (int i = 0; i < count; i++) {
+            origins[i] = origin + glm::vec3(unit(rng), unit(rng), unit(rng)) * extent;
+            directions[i] = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) - 0.5f);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<glm::ivec3> cast(count, glm::ivec3(INT_MAX));
+        uint64_t steps = 0;
+        for (int i = 0; i < count; i++) {
+            RaycastHit hit;
+            if (Raycast(vm, origins[i], directions[i], max_distance, hit)) cast[i] = hit.position;
+            steps += hit.steps;
+        }
+        auto middle = std::chrono::steady_clock::now();
+
+        std::vector<glm::ivec3> walked(count, glm::ivec3(INT_MAX));
+        for (int i = 0; i < count; i++) {
+            glm::vec3 o = origins[i];
+            glm::vec3 d = directions[i];
+            glm::ivec3 cell = glm::ivec3(glm::floor(o));
+            glm::ivec3 step = glm::ivec3(glm::sign(d));
+            glm::vec3 next = glm::vec3(
+                d.x != 0.0f ? ((d.x > 0.0f ? cell.x + 1 : cell.x) - o.x) / d.x : INFINITY,
+                d.y != 0.0f ? ((d.y > 0.0f ? cell.y + 1 : cell.y) - o.y) / d.y : INFINITY,
+                d.z != 0.0f ? ((d.z > 0.0f ? cell.z + 1 : cell.z) - o.z) / d.z : INFINITY);
+            glm::vec3 delta = glm::abs(1.0f / d);
+            VoxelCursor cursor(vm, cell);
+            float t = 0.0f;
+            while (t <= max_distance) {
+                if (cursor.Get().solid()) {
+                    walked[i] = cursor.GetPosition();
+                    break;
+                }
+                uint8_t axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+                t = next[axis];
+                next[axis] += delta[axis];
+                cursor.Move(axis, step[axis]);
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        int hits = 0;
+        int mismatches = 0;
+        for (int i = 0; i < count; i++) {
+            hits += cast[i].x != INT_MAX;
+            mismatches += cast[i] != walked[i];
+        }
+        double cast_ms = std::chrono::duration<double, std::milli>(middle - start).count();
+        double walk_ms = std::chrono::duration<double, std::milli>(end - middle).count();
+        Print("Raycast: " + std::to_string(cast_ms) + "ms, DDA: " + std::to_string(walk_ms) + "ms, " + std::to_string(hits) + " hits, " + std::to_string(mismatches) + " differ, " + std::to_string(double(steps) / count) + " steps per ray");
+    });
+
+    // random columns: the top solid voxel by a GetVoxel loop from the top of the world against GetSurfaceHeight
+    console.CreateCommand("bench_surface", [this](int count){
+        VoxelManager &vm = GetModule<VoxelManager>();
+        glm::ivec3 origin = vm.chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+        glm::ivec3 extent = glm::ivec3(vm.chunk_occupancy.size) * glm::ivec3(CHUNK_WIDTH);
+
+        std::mt19937 rng(1234);
+        std::vector<glm::ivec2> columns(count);
+        for (glm::ivec2 &c : columns)
+            c = glm::ivec2(origin.x + rng() % extent.x, origin.z + rng() % extent.z);
+        std::vector<int32_t> looped(count, SURFACE_HEIGHT_NONE);
+        std::vector<int32_t> cached(count);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            for (int32_t y = origin.y + extent.y - 1; y >= origin.y; y--) {
+                if (!vm.GetVoxel(glm::ivec3(columns[i].x, y, columns[i].y)).solid()) continue;
+                looped[i] = y;
+                break;
+            }
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) cached[i] = vm.GetSurfaceHeight(columns[i].x, columns[i].y);
+        auto end = std::chrono::steady_clock::now();
+
+        double loop_ms = std::chrono::duration<double, std::milli>(middle - start).count();
+        double cache_ms = std::chrono::duration<double, std::milli>(end - middle).count();
+        Print("GetVoxel loop: " + std::to_string(loop_ms) + "ms, GetSurfaceHeight: " + std::to_string(cache_ms) + "ms" + (looped == cached ? "" : " (MISMATCH)"));
+    });
+
+    // bulk importers, log how long the import took and how much the world grew
+    console.CreateCommand("import_vox", [this](std::string path, int x, int y, int z){
+        VoxelManager &vm = GetModule<VoxelManager>();
+        size_t chunks = vm.allocated_chunks.size();
+        auto start = std::chrono::steady_clock::now();
+        bool ok = ImportVox(vm, path, glm::ivec3(x, y, z));
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) { Print("could not import " + path); return; }
+        Print("imported " + path + " in " + std::to_string(ms) + "ms, " + std::to_string(vm.allocated_chunks.size() - chunks) + " new chunks");
+    });
+
+    console.CreateCommand("import_heightmap", [this](std::string path, int x, int y, int z){
+        VoxelManager &vm = GetModule<VoxelManager>();
+        HeightmapImport settings;
+        settings.surface.set_rgb(8, 24, 5);
+        settings.surface.set_solid(true);
+        settings.soil.set_rgb(16, 10, 5);
+        settings.soil.set_solid(true);
+        settings.rock.set_rgb(14, 14, 15);
+        settings.rock.set_solid(true);
+
+        size_t chunks = vm.allocated_chunks.size();
+        auto start = std::chrono::steady_clock::now();
+        bool ok = ImportHeightmap(vm, path, glm::ivec3(x, y, z), settings);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) { Print("could not import " + path); return; }
+        Print("imported " + path + " in " + std::to_string(ms) + "ms, " + std::to_string(vm.allocated_chunks.size() - chunks) + " new chunks");
+    });
+
+    // queued edits show up on the next frame, the contrees catch up over the frames after
+    console.CreateCommand("edit_sphere", [this](float x, float y, float z, float radius, int solid){
+        Voxel voxel{};
+        if (solid) {
+            voxel.set_rgb(20, 20, 22);
+            voxel.set_solid(true);
+        }
+        GetModule<VoxelManager>().QueueEdit(VoxelEdit::Sphere(glm::vec3(x, y, z), radius, voxel));
+    });
+
 }
 
 void Test::Process() {
@@ -40,5 +236,4 @@ void Test::Process() {
     if (input.IsReleased("forward")) {
         console.Log("released", Console::LogLevel::Info);
     }
-}
-
+}
\ No newline at end of file
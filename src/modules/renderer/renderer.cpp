@@ -69,12 +69,16 @@ void Renderer::Init() {
 
     SDL_SetGPUAllowedFramesInFlight(device, 1);
     SetVSync(false); // setting to false uncaps framerate
+
+    staging.Create(device, 16 * 1024 * 1024);
 }
 
 void Renderer::Process() {
     Window &window = GetModule<Window>();
     glm::ivec2 size = window.GetSize();
+    staging.Poll(); // readbacks of earlier frames the GPU finished
     SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(device);
+    staging.Flush(cmd); // everything uploaded since the last frame, ahead of the passes reading it
 
     SDL_GPUTexture *swapTex = nullptr;
     Uint32 sw = 0, sh = 0;
@@ -89,7 +93,7 @@ void Renderer::Process() {
         pass->Execute(cmd);
     }
 
-    SDL_SubmitGPUCommandBuffer(cmd);
+    staging.Submitted(SDL_SubmitGPUCommandBufferAndAcquireFence(cmd));
 }
 
 void Renderer::Shutdown() {
@@ -103,6 +107,7 @@ void Renderer::Shutdown() {
         delete shaderPass;
     }
     shaderPasses.clear();
+    staging.Destroy(); // after the resources, their buffers are released through it
 
     if (device) SDL_DestroyGPUDevice(device);
 }
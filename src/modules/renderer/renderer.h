@@ -3,6 +3,8 @@
 #include "engine.h"
 #include "shaderpasses/computepass.h"
 #include "resources/texture.h"
+#include "resources/buffer.h"
+#include "stagingring.h"
 
 #include <vector>
 #include <unordered_map>
@@ -24,6 +26,9 @@ class Renderer : public EngineModule {
         ResourceType* CreateResource() {
             ResourceType* resource = new ResourceType(device);
 
+            if constexpr (std::is_base_of_v<Buffer, ResourceType>)
+                resource->staging = &staging;
+
             if constexpr (std::is_base_of_v<IResource, ResourceType>)
                 resources.push_back(resource);
 
@@ -45,6 +50,7 @@ class Renderer : public EngineModule {
         Texture swapchainTexture{device};
     private:
         SDL_GPUDevice* device = nullptr; 
+        StagingRing staging{};
 
         std::vector<IResource*> resources;
         std::vector<IExecutableResource*> executableResources;
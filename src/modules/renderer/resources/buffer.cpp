@@ -1,5 +1,7 @@
 #include "buffer.h"
 
+#include <algorithm>
+
 Buffer::~Buffer() {
     Destroy();
 }
@@ -17,7 +19,8 @@ void Buffer::Create() {
 
 void Buffer::Destroy() {
     if (gpu_resource) {
-        SDL_ReleaseGPUBuffer(device, gpu_resource);
+        if (staging) staging->Release(gpu_resource); // staged copies may still target it
+        else SDL_ReleaseGPUBuffer(device, gpu_resource);
         gpu_resource = nullptr;
     }
 }
@@ -27,6 +30,11 @@ SDL_GPUBuffer* Buffer::GetGPU() {
 }
 
 void Buffer::Upload(void *source, size_t cpu_start, size_t gpu_start, size_t size) {
+    if (staging) {
+        staging->Upload(gpu_resource, gpu_start, (uint8_t*)source + cpu_start, size);
+        return;
+    }
+
     SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(device);
     SDL_GPUCopyPass *pass = SDL_BeginGPUCopyPass(cmd);
 
@@ -58,6 +66,52 @@ void Buffer::Upload(void *source, size_t cpu_start, size_t gpu_start, size_t siz
     SDL_SubmitGPUCommandBuffer(cmd);
 }
 
+void Buffer::Upload(const void *source, std::span<const BufferRange> ranges, size_t gpu_base) {
+    if (staging) {
+        for (const BufferRange &range : ranges) staging->Upload(gpu_resource, gpu_base + range.offset, (const uint8_t*)source + range.offset, range.size);
+        return;
+    }
+
+    size_t total = 0;
+    for (const BufferRange &range : ranges) total += range.size;
+    if (total == 0) return;
+
+    SDL_GPUTransferBufferCreateInfo tbci{};
+    tbci.size = static_cast<Uint32>(total);
+    tbci.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    SDL_GPUTransferBuffer *transferBuffer = SDL_CreateGPUTransferBuffer(device, &tbci);
+
+    uint8_t *mapped = (uint8_t*)SDL_MapGPUTransferBuffer(device, transferBuffer, false);
+    size_t packed = 0;
+    for (const BufferRange &range : ranges) {
+        memcpy(mapped + packed, (const uint8_t*)source + range.offset, range.size);
+        packed += range.size;
+    }
+    SDL_UnmapGPUTransferBuffer(device, transferBuffer);
+
+    SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(device);
+    SDL_GPUCopyPass *pass = SDL_BeginGPUCopyPass(cmd);
+    packed = 0;
+    for (const BufferRange &range : ranges) {
+        if (range.size == 0) continue;
+        SDL_GPUTransferBufferLocation tsource{};
+        tsource.transfer_buffer = transferBuffer;
+        tsource.offset = static_cast<Uint32>(packed);
+
+        SDL_GPUBufferRegion tdestination{};
+        tdestination.buffer = gpu_resource;
+        tdestination.offset = static_cast<Uint32>(gpu_base + range.offset);
+        tdestination.size = static_cast<Uint32>(range.size);
+
+        SDL_UploadToGPUBuffer(pass, &tsource, &tdestination, false);
+        packed += range.size;
+    }
+    SDL_EndGPUCopyPass(pass);
+    SDL_SubmitGPUCommandBuffer(cmd);
+
+    SDL_ReleaseGPUTransferBuffer(device, transferBuffer);
+}
+
 void Buffer::Download(void *dest, size_t cpu_start, size_t gpu_start, size_t size) {
     SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(device);
     SDL_GPUCopyPass *pass = SDL_BeginGPUCopyPass(cmd);
@@ -77,15 +131,27 @@ void Buffer::Download(void *dest, size_t cpu_start, size_t gpu_start, size_t siz
     tdestination.offset = 0;
 
     SDL_DownloadFromGPUBuffer(pass, &tsource, &tdestination);
+    SDL_EndGPUCopyPass(pass);
+
+    // the data is only there once the copy ran
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    SDL_WaitForGPUFences(device, true, &fence, 1);
+    SDL_ReleaseGPUFence(device, fence);
 
     uint8_t *mapped = (uint8_t*)SDL_MapGPUTransferBuffer(device, transferBuffer, false);
     memcpy((uint8_t*)dest + cpu_start, mapped, size);
     SDL_UnmapGPUTransferBuffer(device, transferBuffer);
 
     SDL_ReleaseGPUTransferBuffer(device, transferBuffer);
+}
 
-    SDL_EndGPUCopyPass(pass);
-    SDL_SubmitGPUCommandBuffer(cmd);
+ReadbackTicket Buffer::DownloadAsync(size_t gpu_start, size_t size, ReadbackCallback callback) {
+    if (staging) return staging->Download(gpu_resource, gpu_start, size, std::move(callback));
+
+    std::vector<uint8_t> data(size);
+    Download(data.data(), 0, gpu_start, size);
+    if (callback) callback(data.data(), size);
+    return 0;
 }
 
 void Buffer::SetSize(size_t size) {
@@ -93,6 +159,52 @@ void Buffer::SetSize(size_t size) {
     Create();
 }
 
+void Buffer::Grow(size_t size) {
+    if (size <= this->size) return;
+    SDL_GPUBuffer *old = gpu_resource;
+    size_t old_size = this->size;
+    gpu_resource = nullptr;
+    this->size = size;
+    Create();
+    if (!old) return;
+    if (staging) { // after the uploads already staged for the old buffer, before the ones for the new one
+        staging->Copy(old, 0, gpu_resource, 0, old_size);
+        staging->Release(old);
+        return;
+    }
+
+    SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(device);
+    SDL_GPUCopyPass *pass = SDL_BeginGPUCopyPass(cmd);
+    SDL_GPUBufferLocation source{old, 0};
+    SDL_GPUBufferLocation destination{gpu_resource, 0};
+    SDL_CopyGPUBufferToBuffer(pass, &source, &destination, static_cast<Uint32>(old_size), false);
+    SDL_EndGPUCopyPass(pass);
+    SDL_SubmitGPUCommandBuffer(cmd);
+
+    SDL_ReleaseGPUBuffer(device, old); // released once the copy is done
+}
+
+void Buffer::Reserve(size_t size) {
+    if (size <= this->size) return;
+    Grow(std::max(size, this->size * 2));
+}
+
+void Buffer::CopyWithin(size_t source, size_t destination, size_t size) {
+    if (size == 0 || !gpu_resource) return;
+    if (staging) {
+        staging->Copy(gpu_resource, source, gpu_resource, destination, size);
+        return;
+    }
+
+    SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(device);
+    SDL_GPUCopyPass *pass = SDL_BeginGPUCopyPass(cmd);
+    SDL_GPUBufferLocation from{gpu_resource, static_cast<Uint32>(source)};
+    SDL_GPUBufferLocation to{gpu_resource, static_cast<Uint32>(destination)};
+    SDL_CopyGPUBufferToBuffer(pass, &from, &to, static_cast<Uint32>(size), false);
+    SDL_EndGPUCopyPass(pass);
+    SDL_SubmitGPUCommandBuffer(cmd);
+}
+
 size_t Buffer::GetSize() {
     return this->size;
 }
\ No newline at end of file
@@ -5,8 +5,16 @@
 #include <cstdint>
 #include <cstring>
 #include <vector>
+#include <span>
 
 #include "../resource.h"
+#include "../stagingring.h"
+
+// byte range of the source, copied to the same offset past the upload's base in the buffer
+struct BufferRange {
+    size_t offset = 0;
+    size_t size = 0;
+};
 
 class Buffer : public Resource<SDL_GPUBuffer> {
     public:
@@ -18,13 +26,21 @@ class Buffer : public Resource<SDL_GPUBuffer> {
         SDL_GPUBuffer* GetGPU(void) override;
 
         void Upload(void *source, size_t cpu_start, size_t gpu_start, size_t size);
-        void Download(void *dest, size_t cpu_start, size_t gpu_start, size_t size);
+        void Upload(const void *source, std::span<const BufferRange> ranges, size_t gpu_base = 0); // all ranges through one transfer buffer and copy pass
+        void Download(void *dest, size_t cpu_start, size_t gpu_start, size_t size); // waits for the GPU, see DownloadAsync
+        // reads back what the buffer holds once the GPU finished the frames so far, see StagingRing::Download. without a
+        // staging ring it falls back to Download and the callback runs right away (the ticket is then 0)
+        ReadbackTicket DownloadAsync(size_t gpu_start, size_t size, ReadbackCallback callback = nullptr);
 
         void SetSize(size_t size);
         size_t GetSize();
+        void Grow(size_t size); // recreates the buffer larger and copies the old contents over on the GPU
+        void Reserve(size_t size); // Grow, but at least doubling so repeated small growth stays rare
+        void CopyWithin(size_t source, size_t destination, size_t size); // GPU side, the ranges must not overlap
 
         size_t size = 0;
         SDL_GPUBufferUsageFlags usage = 0;
+        StagingRing *staging = nullptr; // set by Renderer::CreateResource, uploads then land with the next frame instead of right away
 };
 
 template<typename T>
@@ -35,8 +51,11 @@ class TypedBuffer : public Buffer {
         using Buffer::Create;
         using Buffer::Upload;
         using Buffer::Download;
+        using Buffer::DownloadAsync;
         using Buffer::SetSize;
         using Buffer::GetSize;
+        using Buffer::Grow;
+        using Buffer::Reserve;
 
         void Upload(const T *data, size_t count, size_t elementOffset = 0) {
             Buffer::Upload((void*)data, 0, elementOffset * sizeof(T), count * sizeof(T));
@@ -54,10 +73,22 @@ class TypedBuffer : public Buffer {
             Download(out.data(), out.size(), elementOffset);
         }
 
+        ReadbackTicket DownloadAsync(size_t count, size_t elementOffset, std::function<void(const T *data, size_t count)> callback) {
+            return Buffer::DownloadAsync(elementOffset * sizeof(T), count * sizeof(T), [callback](const void *data, size_t size) {
+                callback((const T*)data, size / sizeof(T));
+            });
+        }
+
         void SetSize(size_t elementCount) {
             Buffer::SetSize(sizeof(T) * elementCount);
         }
         size_t GetSize() {
             return Buffer::GetSize() / sizeof(T);
         }
+        void Grow(size_t elementCount) {
+            Buffer::Grow(sizeof(T) * elementCount);
+        }
+        void Reserve(size_t elementCount) {
+            Buffer::Reserve(sizeof(T) * elementCount);
+        }
 };
\ No newline at end of file
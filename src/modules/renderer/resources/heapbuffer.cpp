@@ -0,0 +1,34 @@
+#include "heapbuffer.h"
+
+#include <algorithm>
+
+size_t HeapBuffer::Allocate(size_t size) {
+    ranges.Extend(this->size);
+    size_t offset = ranges.Allocate(size);
+    if (offset != RangeAllocator::INVALID) return offset;
+
+    // the free tail may already cover part of it, growing by the full size keeps this to one step
+    Reserve(ranges.GetCapacity() + ranges.Align(size));
+    ranges.Extend(this->size);
+    grow_count++;
+    return ranges.Allocate(size);
+}
+
+void HeapBuffer::Free(size_t offset) {
+    ranges.Free(offset);
+}
+
+bool HeapBuffer::Fit(HeapRegion &region, size_t size) {
+    if (size <= region.capacity && region.capacity > 0) return false;
+    size_t grown = std::max(size, region.capacity * 2);
+    region.offset = region.capacity == 0 ? Allocate(grown) : Reallocate(region.offset, region.size, grown);
+    region.capacity = grown;
+    return true;
+}
+
+size_t HeapBuffer::Reallocate(size_t offset, size_t used, size_t size) {
+    size_t moved = Allocate(size);
+    CopyWithin(offset, moved, std::min(used, size));
+    Free(offset); // later uploads into the freed range are recorded after the copy out of it
+    return moved;
+}
\ No newline at end of file
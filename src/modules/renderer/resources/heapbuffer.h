@@ -0,0 +1,34 @@
+#pragma once
+
+#include "buffer.h"
+#include "rangeallocator/rangeallocator.hpp"
+
+// byte range of one array in a HeapBuffer, size is what the GPU side holds of it
+struct HeapRegion {
+    size_t offset = 0;
+    size_t size = 0;
+    size_t capacity = 0;
+};
+
+// One storage buffer that several growing arrays are suballocated from, each addressed by its byte offset. Shaders
+// bind the heap once and are told the offsets, so moving or adding an array needs no new binding. Running out of room
+// grows the whole buffer at least twofold (Buffer::Reserve), which keeps every offset valid.
+class HeapBuffer : public Buffer {
+    public:
+        static constexpr size_t ALIGNMENT = 256;
+
+        using Buffer::Buffer;
+
+        size_t Allocate(size_t size);
+        void Free(size_t offset);
+        // moves an allocation into size bytes, the first used bytes are copied over on the GPU. returns the new offset
+        size_t Reallocate(size_t offset, size_t used, size_t size);
+        // makes room for size bytes in region, moving it to at least twice its capacity when it is too small (region.size
+        // bytes come along). returns whether the region moved
+        bool Fit(HeapRegion &region, size_t size);
+
+        size_t GetGrowCount(void) const { return grow_count; }
+    private:
+        RangeAllocator ranges{ALIGNMENT};
+        size_t grow_count = 0;
+};
\ No newline at end of file
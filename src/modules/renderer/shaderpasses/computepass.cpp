@@ -15,7 +15,7 @@ void ComputePass::Create() {
     createInfo.num_readonly_storage_textures = readonly_storage_textures.size();
     createInfo.num_readonly_storage_buffers = readonly_storage_buffers.size();
     createInfo.num_readwrite_storage_buffers = readwrite_storage_buffers.size();
-    createInfo.num_uniform_buffers = uniform_buffers.size();
+    createInfo.num_uniform_buffers = uniform_buffers.size() + push_constants.size();
 
     createInfo.threadcount_x = threadcount.x;
     createInfo.threadcount_y = threadcount.y;
@@ -11,6 +11,7 @@
 #include "../resources/texture.h"
 #include "../resources/buffer.h"
 #include "../resources//sampler.h"
+#include "../resource.h"
 
 class ComputePass : public ShaderPass {
     public:
@@ -27,6 +28,8 @@ class ComputePass : public ShaderPass {
         std::vector<Texture*> readonly_storage_textures;
         std::vector<Buffer*> readonly_storage_buffers;
         std::vector<Buffer*> uniform_buffers;
+        // uniform data the renderer pushes once per frame (see PushConstant), the pass only declares their slots
+        std::vector<IExecutableResource*> push_constants;
 
         std::vector<SDL_GPUStorageTextureReadWriteBinding> sdl_readwrite_storage_textures;
         std::vector<SDL_GPUStorageBufferReadWriteBinding> sdl_readwrite_storage_buffers;
@@ -0,0 +1,218 @@
+#include "stagingring.h"
+
+#include <cstring>
+#include <algorithm>
+
+static constexpr size_t STAGING_ALIGNMENT = 16;
+
+void StagingRing::Create(SDL_GPUDevice *device, size_t capacity) {
+    this->device = device;
+    this->capacity = capacity;
+
+    SDL_GPUTransferBufferCreateInfo tbci{};
+    tbci.size = static_cast<Uint32>(capacity);
+    tbci.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    ring = SDL_CreateGPUTransferBuffer(device, &tbci);
+}
+
+void StagingRing::Destroy() {
+    if (device) SDL_WaitForGPUIdle(device);
+    for (Frame &frame : in_flight) {
+        if (frame.fence) SDL_ReleaseGPUFence(device, frame.fence);
+        if (frame.download) SDL_ReleaseGPUTransferBuffer(device, frame.download);
+    }
+    in_flight.clear();
+    downloads.clear();
+    completed.clear();
+    results.clear();
+    for (SDL_GPUTransferBuffer *buffer : overflow) SDL_ReleaseGPUTransferBuffer(device, buffer);
+    overflow.clear();
+    for (SDL_GPUBuffer *buffer : released) SDL_ReleaseGPUBuffer(device, buffer);
+    released.clear();
+    staged.clear();
+
+    if (ring) {
+        if (mapped) SDL_UnmapGPUTransferBuffer(device, ring);
+        SDL_ReleaseGPUTransferBuffer(device, ring);
+    }
+    ring = nullptr;
+    mapped = nullptr;
+}
+
+// frees the bytes of every frame whose fence signaled, waiting for the oldest one when asked to
+void StagingRing::Retire(bool wait) {
+    while (!in_flight.empty() && in_flight.front().fence != nullptr) {
+        Frame &frame = in_flight.front();
+        if (!SDL_QueryGPUFence(device, frame.fence)) {
+            if (!wait) break;
+            SDL_WaitForGPUFences(device, true, &frame.fence, 1);
+            wait = false;
+        }
+        SDL_ReleaseGPUFence(device, frame.fence);
+        Finish(frame);
+        in_flight.pop_front();
+    }
+    if (used == 0) head = 0;
+}
+
+// the frame's copies are done, its ring bytes are free and its readbacks can be picked up
+void StagingRing::Finish(Frame &frame) {
+    used -= frame.bytes;
+    if (frame.download) {
+        // callbacks wait for Poll, this may run in the middle of an Upload
+        const uint8_t *mapped = (const uint8_t*)SDL_MapGPUTransferBuffer(device, frame.download, false);
+        for (Readback &readback : frame.readbacks) {
+            std::vector<uint8_t> data(mapped + readback.download_offset, mapped + readback.download_offset + readback.size);
+            if (readback.callback) completed.push_back({std::move(readback.callback), std::move(data)});
+            else results[readback.ticket] = std::move(data);
+        }
+        SDL_UnmapGPUTransferBuffer(device, frame.download);
+        SDL_ReleaseGPUTransferBuffer(device, frame.download);
+    }
+    if (!frame.readbacks.empty()) completed_ticket = frame.readbacks.back().ticket;
+}
+
+bool StagingRing::Allocate(size_t size, size_t &offset) {
+    size = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    if (ring == nullptr || size > capacity / 2) return false; // bulk uploads would only flush the ring
+
+    Retire(false);
+    while (true) {
+        size_t waste = head + size > capacity ? capacity - head : 0; // a copy never wraps, skip the tail end instead
+        if (used + waste + size <= capacity) {
+            offset = waste > 0 ? 0 : head;
+            head = offset + size;
+            used += waste + size;
+            frame_bytes += waste + size;
+            return true;
+        }
+        if (in_flight.empty() || in_flight.front().fence == nullptr) return false; // the staged frame alone fills the ring
+        Retire(true);
+    }
+}
+
+void StagingRing::Upload(SDL_GPUBuffer *destination, size_t offset, const void *data, size_t size) {
+    if (size == 0) return;
+    staged_bytes += size;
+
+    size_t ring_offset;
+    if (Allocate(size, ring_offset)) {
+        if (!mapped) mapped = (uint8_t*)SDL_MapGPUTransferBuffer(device, ring, false);
+        memcpy(mapped + ring_offset, data, size);
+        staged.push_back({ring, nullptr, static_cast<uint32_t>(ring_offset), destination, static_cast<uint32_t>(offset), static_cast<uint32_t>(size)});
+        return;
+    }
+
+    SDL_GPUTransferBufferCreateInfo tbci{};
+    tbci.size = static_cast<Uint32>(size);
+    tbci.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    SDL_GPUTransferBuffer *transfer = SDL_CreateGPUTransferBuffer(device, &tbci);
+    void *target = SDL_MapGPUTransferBuffer(device, transfer, false);
+    memcpy(target, data, size);
+    SDL_UnmapGPUTransferBuffer(device, transfer);
+    overflow.push_back(transfer);
+    staged.push_back({transfer, nullptr, 0, destination, static_cast<uint32_t>(offset), static_cast<uint32_t>(size)});
+}
+
+void StagingRing::Copy(SDL_GPUBuffer *source, size_t source_offset, SDL_GPUBuffer *destination, size_t destination_offset, size_t size) {
+    if (size == 0) return;
+    staged.push_back({nullptr, source, static_cast<uint32_t>(source_offset), destination, static_cast<uint32_t>(destination_offset), static_cast<uint32_t>(size)});
+}
+
+void StagingRing::Release(SDL_GPUBuffer *buffer) {
+    if (buffer) released.push_back(buffer);
+}
+
+ReadbackTicket StagingRing::Download(SDL_GPUBuffer *source, size_t offset, size_t size, ReadbackCallback callback) {
+    downloads.push_back({next_ticket, source, static_cast<uint32_t>(offset), static_cast<uint32_t>(size), 0, std::move(callback)});
+    return next_ticket++;
+}
+
+bool StagingRing::Take(ReadbackTicket ticket, std::vector<uint8_t> &out) {
+    auto found = results.find(ticket);
+    if (found == results.end()) return false;
+    out = std::move(found->second);
+    results.erase(found);
+    return true;
+}
+
+void StagingRing::Poll() {
+    Retire(false);
+    std::vector<Completed> ready;
+    ready.swap(completed); // a callback may queue the next download
+    for (Completed &done : ready) done.callback(done.data.data(), done.data.size());
+}
+
+void StagingRing::Flush(SDL_GPUCommandBuffer *cmd) {
+    if (mapped) {
+        SDL_UnmapGPUTransferBuffer(device, ring);
+        mapped = nullptr;
+    }
+
+    Frame frame{nullptr, frame_bytes, nullptr, {}};
+    if (!downloads.empty()) {
+        size_t total = 0;
+        for (Readback &readback : downloads) {
+            readback.download_offset = static_cast<uint32_t>(total);
+            total += (readback.size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+        }
+        SDL_GPUTransferBufferCreateInfo tbci{};
+        tbci.size = static_cast<Uint32>(std::max<size_t>(total, STAGING_ALIGNMENT));
+        tbci.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+        frame.download = SDL_CreateGPUTransferBuffer(device, &tbci);
+        frame.readbacks.swap(downloads);
+    }
+
+    if (!staged.empty() || frame.download) {
+        SDL_GPUCopyPass *pass = SDL_BeginGPUCopyPass(cmd);
+        for (const StagedCopy &copy : staged) {
+            if (copy.transfer) {
+                SDL_GPUTransferBufferLocation source{copy.transfer, copy.source_offset};
+                SDL_GPUBufferRegion destination{copy.destination, copy.destination_offset, copy.size};
+                SDL_UploadToGPUBuffer(pass, &source, &destination, false);
+            } else {
+                SDL_GPUBufferLocation source{copy.source, copy.source_offset};
+                SDL_GPUBufferLocation destination{copy.destination, copy.destination_offset};
+                SDL_CopyGPUBufferToBuffer(pass, &source, &destination, copy.size, false);
+            }
+        }
+        // after the uploads, a readback sees everything staged before it and what earlier frames' passes wrote
+        for (const Readback &readback : frame.readbacks) {
+            SDL_GPUBufferRegion source{readback.source, readback.source_offset, readback.size};
+            SDL_GPUTransferBufferLocation destination{frame.download, readback.download_offset};
+            SDL_DownloadFromGPUBuffer(pass, &source, &destination);
+        }
+        SDL_EndGPUCopyPass(pass);
+        staged.clear();
+    }
+
+    // SDL keeps both alive until the command buffer is done with them
+    for (SDL_GPUTransferBuffer *buffer : overflow) SDL_ReleaseGPUTransferBuffer(device, buffer);
+    overflow.clear();
+    for (SDL_GPUBuffer *buffer : released) SDL_ReleaseGPUBuffer(device, buffer);
+    released.clear();
+
+    in_flight.push_back(std::move(frame));
+    frame_bytes = 0;
+    staged_bytes = 0;
+}
+
+void StagingRing::Submitted(SDL_GPUFence *fence) {
+    if (in_flight.empty() || in_flight.back().fence != nullptr) {
+        if (fence) SDL_ReleaseGPUFence(device, fence);
+        return;
+    }
+    if (fence == nullptr) { // nothing to wait on, only a full wait can finish the frame
+        SDL_WaitForGPUIdle(device);
+        Retire(false); // the older frames first, readbacks complete in order
+        Finish(in_flight.back());
+        in_flight.pop_back();
+        return;
+    }
+    if (in_flight.back().bytes == 0 && !in_flight.back().download) { // nothing of the frame to guard
+        in_flight.pop_back();
+        SDL_ReleaseGPUFence(device, fence);
+        return;
+    }
+    in_flight.back().fence = fence;
+}
\ No newline at end of file
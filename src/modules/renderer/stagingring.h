@@ -0,0 +1,98 @@
+#pragma once
+
+#include "SDL3/SDL_gpu.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+using ReadbackTicket = uint64_t; // 0 is never handed out
+using ReadbackCallback = std::function<void(const void *data, size_t size)>;
+
+// One transfer buffer that every buffer upload of a frame is suballocated from. Uploads are copied in right away and
+// recorded later, by Flush, as one copy pass at the start of the frame's command buffer. The bytes of a frame are
+// reused once the fence of the command buffer they were recorded into has signaled. The ring stays mapped while uploads
+// are staged and is only unmapped while Flush records (SDL wants transfer buffers unmapped for that).
+// Downloads ride along: they are recorded behind the uploads in the same copy pass and finish when the frame's fence
+// signals, a frame or more later, without the CPU ever waiting for them.
+class StagingRing {
+    public:
+        void Create(SDL_GPUDevice *device, size_t capacity);
+        void Destroy(void);
+
+        // copies data now, the upload to destination happens at the next Flush
+        void Upload(SDL_GPUBuffer *destination, size_t offset, const void *data, size_t size);
+        // buffer to buffer copy, in order with the uploads around it. source and destination may be the same buffer as
+        // long as the ranges don't overlap
+        void Copy(SDL_GPUBuffer *source, size_t source_offset, SDL_GPUBuffer *destination, size_t destination_offset, size_t size);
+        // releases buffer once the next Flush recorded everything staged for it
+        void Release(SDL_GPUBuffer *buffer);
+
+        // Copies size bytes at offset of source back once the GPU got to the next Flush. The callback runs from Poll, on
+        // the thread driving the renderer. Without one the bytes wait for Take.
+        ReadbackTicket Download(SDL_GPUBuffer *source, size_t offset, size_t size, ReadbackCallback callback = nullptr);
+        bool IsDone(ReadbackTicket ticket) const { return ticket != 0 && ticket <= completed_ticket; }
+        bool Take(ReadbackTicket ticket, std::vector<uint8_t> &out); // false until IsDone, and after the first Take
+
+        void Flush(SDL_GPUCommandBuffer *cmd);
+        void Submitted(SDL_GPUFence *fence); // fence of the command buffer the last Flush recorded into, owned from now on
+        void Poll(void); // finishes the frames the GPU is done with and runs their readback callbacks
+
+        size_t GetStagedBytes(void) const { return staged_bytes; } // staged since the last Flush
+    private:
+        struct StagedCopy {
+            SDL_GPUTransferBuffer *transfer; // nullptr for a buffer to buffer copy
+            SDL_GPUBuffer *source;
+            uint32_t source_offset;
+            SDL_GPUBuffer *destination;
+            uint32_t destination_offset;
+            uint32_t size;
+        };
+
+        struct Readback {
+            ReadbackTicket ticket;
+            SDL_GPUBuffer *source;
+            uint32_t source_offset;
+            uint32_t size;
+            uint32_t download_offset; // in the frame's download buffer
+            ReadbackCallback callback;
+        };
+
+        struct Frame {
+            SDL_GPUFence *fence;
+            size_t bytes; // ring bytes the frame holds, wrap waste included
+            SDL_GPUTransferBuffer *download; // every readback of the frame packed together
+            std::vector<Readback> readbacks;
+        };
+
+        struct Completed {
+            ReadbackCallback callback;
+            std::vector<uint8_t> data;
+        };
+
+        bool Allocate(size_t size, size_t &offset);
+        void Retire(bool wait);
+        void Finish(Frame &frame);
+
+        SDL_GPUDevice *device = nullptr;
+        SDL_GPUTransferBuffer *ring = nullptr;
+        uint8_t *mapped = nullptr;
+        size_t capacity = 0;
+        size_t head = 0;
+        size_t used = 0;          // ring bytes held by in flight frames and the staged one
+        size_t frame_bytes = 0;   // ring bytes of the staged frame
+        size_t staged_bytes = 0;
+
+        std::vector<StagedCopy> staged{};
+        std::vector<SDL_GPUTransferBuffer*> overflow{}; // own transfer buffers for uploads the ring can't hold
+        std::vector<SDL_GPUBuffer*> released{};
+        std::vector<Readback> downloads{}; // recorded by the next Flush
+        std::vector<Completed> completed{};  // waiting for Poll to run their callbacks
+        std::unordered_map<ReadbackTicket, std::vector<uint8_t>> results{};
+        ReadbackTicket next_ticket = 1;
+        ReadbackTicket completed_ticket = 0;
+        std::deque<Frame> in_flight{};
+};
\ No newline at end of file
@@ -1,12 +1,20 @@
+#pragma once
+
 #include <cstdint>
+#include "glm/vec3.hpp"
+#include "glm/common.hpp"
 #include "relptr/relptr.hpp"
 
 static constexpr uint8_t CONTREE_NODE_WIDTH = 4;
+static constexpr uint8_t CONTREE_NODE_SHIFT = 2; // log2(CONTREE_NODE_WIDTH)
 static constexpr uint8_t CONTREE_MAX_DEPTH = 3;
 static constexpr uint64_t CONTREE_VOXEL_MASK_FULL = UINT64_MAX;
 static constexpr uint16_t CHUNK_WIDTH = 64; // CONTREE_NODE_WIDTH^CONTREE_MAX_DEPTH
 static constexpr uint32_t CHUNK_FLAG_EXISTS = 0b00000000000000000000000000000001;
 static constexpr uint32_t CHUNK_FLAG_DIRTY  = 0b00000000000000000000000000000010;
+static constexpr uint32_t CHUNK_FLAG_EMPTY  = 0b00000000000000000000000000000100; // no solid voxel, the solid bounds are meaningless
+static constexpr uint32_t CHUNK_FLAG_FULL   = 0b00000000000000000000000000001000; // every voxel is solid
+static constexpr uint32_t CHUNK_FLAG_BRICK  = 0b00000000000000000000000000010000; // voxels live in a dense brick, the root only holds a coarse copy
 static constexpr uint32_t POINTER_EMPTY = UINT32_MAX;
 struct Voxel {
     uint32_t data = 0;
@@ -15,6 +23,7 @@ struct Voxel {
     uint8_t g() const { return (data >> 5) & 0x1F; }
     uint8_t b() const { return (data >> 10) & 0x1F; }
     bool solid() const { return data & 0x8000; }
+    uint16_t material() const { return data >> 16; } // index into VoxelManager::materials
 
     void set_r(uint8_t v) { data = (data & ~0x001F) | (v & 0x1F); }
     void set_g(uint8_t v) { data = (data & ~0x03E0) | ((v & 0x1F) << 5); }
@@ -26,6 +35,8 @@ struct Voxel {
         else data &= ~0x8000;
     }
 
+    void set_material(uint16_t v) { data = (data & 0xFFFF) | (uint32_t(v) << 16); }
+
     std::string to_string() {
         return std::to_string(r()) + "R " + std::to_string(g()) + "G " + std::to_string(b()) + "B";
     }
@@ -36,14 +47,33 @@ struct Voxel {
 
 static constexpr Voxel VOXEL_EMPTY = Voxel{};
 
+static constexpr uint16_t MATERIAL_DEFAULT = 0;
+static constexpr uint32_t MATERIAL_FLAG_LIQUID = 0b00000000000000000000000000000001;
+
+// Shared properties of every voxel that points at this material, uploaded as one global table. There are no per-chunk
+// palettes: every voxel holds its full 16 bit index next to its color, so leaves are as large as before the table.
+struct Material {
+    glm::vec3 color{1.0f};     // multiplied with the voxel color
+    float emissive = 0.0f;     // how much of the voxel color is added on top of the lit color
+    float transparency = 0.0f;
+    float friction = 1.0f;
+    uint32_t sound = 0;        // footstep / break sound set
+    uint32_t flags = 0;
+
+    bool operator==(const Material&) const = default;
+};
+
 struct ContreeNode;
 using ContreeDataBase = RelptrBaseVector<RELPTR_TAG(cb), ContreeNode>;
 struct ContreeNode {
     uint64_t isVoxelMask = CONTREE_VOXEL_MASK_FULL; // bit mask stating if child node data is voxel or pointer, defaults to voxel
+    uint64_t occupancyMask = 0; // bit set when the child is a pointer or a solid voxel, kept by SetVoxel/SetPtr so air can be skipped without reading the payload
     union {
         Voxel voxel_data[CONTREE_NODE_WIDTH*CONTREE_NODE_WIDTH*CONTREE_NODE_WIDTH]{};
         Relptr<ContreeDataBase> child_nodes[CONTREE_NODE_WIDTH*CONTREE_NODE_WIDTH*CONTREE_NODE_WIDTH];
     };
+    Voxel lod_voxel{};     // what a ray that stops at this node sees, the average color of its solid part (see UpdateNodeLod)
+    float coverage = 0.0f; // solid fraction of the node's volume
 
     size_t GetIndex(glm::uvec3 position) {
         return position.x + position.y * CONTREE_NODE_WIDTH + position.z * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
@@ -62,16 +92,23 @@ struct ContreeNode {
         
     }
 
+    bool IsOccupied(size_t index) const {
+        return (occupancyMask >> index) & 1ULL;
+    }
+
     void SetVoxel(size_t index, Voxel value) {
         voxel_data[index] = value;
         uint64_t bit = 1ULL << index;
         isVoxelMask |= bit;
+        if (value.solid()) occupancyMask |= bit;
+        else occupancyMask &= ~bit;
     }
 
     void SetPtr(size_t index, Relptr<ContreeDataBase> value) {
         child_nodes[index] = value;
         uint64_t bit = 1ULL << index;
         isVoxelMask &= ~bit;
+        occupancyMask |= bit;
     }
 
     bool IsUniform() {
@@ -87,22 +124,72 @@ struct ContreeNode {
     }
 };
 
+// chunk local voxel coordinate packed 8 bits per axis, x in the low byte
+static constexpr uint32_t PackChunkLocal(glm::uvec3 position) {
+    return position.x | (position.y << 8) | (position.z << 16);
+}
+
+static constexpr glm::uvec3 UnpackChunkLocal(uint32_t packed) {
+    return glm::uvec3(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF);
+}
+
 struct Chunk {
     glm::ivec3 position{}; // the position in chunk space of this chunk
-    //alignas(16) uint32_t flags = 0; // flags about the chunk
     Relptr<ContreeDataBase> contree_node{};
+    uint32_t flags = CHUNK_FLAG_EXISTS | CHUNK_FLAG_EMPTY; // flags about the chunk
+    uint32_t solid_min = 0; // inclusive chunk local bounds of the solid voxels (PackChunkLocal), may be loose after edits
+    uint32_t solid_max = 0; // until the chunk is canonicalized, but never too small
+    uint32_t brick = POINTER_EMPTY; // brick slot in VoxelManager::brick_data while CHUNK_FLAG_BRICK is set
+
+    // an edit may have made [min, max] solid
+    void GrowSolidBounds(glm::uvec3 min, glm::uvec3 max) {
+        if (!(flags & CHUNK_FLAG_EMPTY)) {
+            min = glm::min(min, UnpackChunkLocal(solid_min));
+            max = glm::max(max, UnpackChunkLocal(solid_max));
+        }
+        solid_min = PackChunkLocal(min);
+        solid_max = PackChunkLocal(max);
+        flags &= ~CHUNK_FLAG_EMPTY;
+    }
 };
 
 using AllocatedChunksBase = RelptrBaseVector<RELPTR_TAG(ac), Chunk>;
 
+// Dense chunk storage for detailed chunks: the low 16 bits (color and solid) of every voxel, x fastest. Only chunks
+// whose voxels all use MATERIAL_DEFAULT can be bricked.
+static constexpr uint32_t CHUNK_BRICK_VOXELS = CHUNK_WIDTH * CHUNK_WIDTH * CHUNK_WIDTH;
+
+static constexpr uint32_t BrickIndex(glm::uvec3 position) {
+    return position.x + position.y * CHUNK_WIDTH + position.z * CHUNK_WIDTH * CHUNK_WIDTH;
+}
+
+// Per chunk distance field over cells of 4x4x4 voxels (the children of the root's children), one byte per cell:
+// the Chebyshev distance in cells to the nearest cell of the chunk that may hold solid voxels, 0 for such a cell.
+static constexpr uint32_t CHUNK_DISTANCE_CELL_WIDTH = 4;
+static constexpr uint32_t CHUNK_DISTANCE_WIDTH = CHUNK_WIDTH / CHUNK_DISTANCE_CELL_WIDTH;
+static constexpr uint32_t CHUNK_DISTANCE_CELLS = CHUNK_DISTANCE_WIDTH * CHUNK_DISTANCE_WIDTH * CHUNK_DISTANCE_WIDTH;
+static constexpr uint8_t CHUNK_DISTANCE_FAR = UINT8_MAX; // nothing solid in the chunk
+
+static constexpr int32_t SURFACE_HEIGHT_NONE = INT32_MIN; // a world column without solid voxels
+
+static constexpr uint32_t CHUNK_PYRAMID_SHIFT = 2; // every pyramid cell covers 4x4x4 cells of the level below
+
+// cells per axis of a level of the chunk pyramid over a directory of the given size
+static constexpr glm::uvec3 ChunkPyramidLevelSize(glm::uvec3 size, uint32_t level) {
+    uint32_t shift = CHUNK_PYRAMID_SHIFT * level;
+    return (size + glm::uvec3((1u << shift) - 1)) >> shift;
+}
+
 struct ChunkPositionsHeader {
     alignas(16) glm::ivec3 position{};
     alignas(16) glm::uvec3 size{};
+    uint32_t pyramid_levels = 0; // levels of VoxelManager::chunk_pyramid
 };
 
 struct ChunkPositions {
     alignas(16) glm::ivec3 position{};
     alignas(16) glm::uvec3 size{};
+    uint32_t pyramid_levels = 0;
     Relptr<AllocatedChunksBase> *chunks = nullptr; // an array of indicies into a chunks array
 
     uint32_t get_size(void) { return size.x*size.y*size.z; }
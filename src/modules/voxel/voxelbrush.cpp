@@ -0,0 +1,84 @@
+#include "voxelbrush.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+// segments shorter than this are treated as a single point
+static constexpr float BRUSH_EPSILON = 1e-6f;
+
+static float SphereDistance(glm::vec3 p, glm::vec3 center, float radius) {
+    return glm::length(p - center) - radius;
+}
+
+static float EllipsoidDistance(glm::vec3 p, glm::vec3 center, glm::vec3 radius) {
+    // scaling to the unit sphere stretches distances by at most 1 / min(radius), which keeps this a lower bound
+    float k = glm::length((p - center) / radius);
+    return (k - 1.0f) * glm::min(radius.x, glm::min(radius.y, radius.z));
+}
+
+static float CapsuleDistance(glm::vec3 p, glm::vec3 a, glm::vec3 b, float radius) {
+    glm::vec3 pa = p - a;
+    glm::vec3 ba = b - a;
+    float baba = glm::dot(ba, ba);
+    float h = baba > BRUSH_EPSILON ? glm::clamp(glm::dot(pa, ba) / baba, 0.0f, 1.0f) : 0.0f;
+    return glm::length(pa - ba * h) - radius;
+}
+
+static float CylinderDistance(glm::vec3 p, glm::vec3 a, glm::vec3 b, float radius) {
+    glm::vec3 ba = b - a;
+    glm::vec3 pa = p - a;
+    float baba = glm::dot(ba, ba);
+    if (baba <= BRUSH_EPSILON) return SphereDistance(p, a, radius);
+
+    float paba = glm::dot(pa, ba);
+    float x = glm::length(pa * baba - ba * paba) - radius * baba;
+    float y = glm::abs(paba - baba * 0.5f) - baba * 0.5f;
+    float x2 = x * x;
+    float y2 = y * y * baba;
+    float d = (glm::max(x, y) < 0.0f) ? -glm::min(x2, y2) : ((x > 0.0f ? x2 : 0.0f) + (y > 0.0f ? y2 : 0.0f));
+    return glm::sign(d) * glm::sqrt(glm::abs(d)) / baba;
+}
+
+static float ConeDistance(glm::vec3 p, glm::vec3 a, glm::vec3 b, float radius) {
+    // capped cone from radius at a down to a point at b
+    float ra = radius;
+    float rb = 0.0f;
+    float rba = rb - ra;
+    float baba = glm::dot(b - a, b - a);
+    if (baba <= BRUSH_EPSILON) return SphereDistance(p, a, 0.0f);
+
+    float papa = glm::dot(p - a, p - a);
+    float paba = glm::dot(p - a, b - a) / baba;
+    float x = glm::sqrt(glm::max(papa - paba * paba * baba, 0.0f));
+    float cax = glm::max(0.0f, x - ((paba < 0.5f) ? ra : rb));
+    float cay = glm::abs(paba - 0.5f) - 0.5f;
+    float k = rba * rba + baba;
+    float f = glm::clamp((rba * (x - ra) + paba * baba) / k, 0.0f, 1.0f);
+    float cbx = x - ra - f * rba;
+    float cby = paba - f;
+    float s = (cbx < 0.0f && cay < 0.0f) ? -1.0f : 1.0f;
+    return s * glm::sqrt(glm::min(cax * cax + cay * cay * baba, cbx * cbx + cby * cby * baba));
+}
+
+float VoxelBrush::Distance(glm::vec3 position) const {
+    switch (shape) {
+        case BrushShape::Sphere:    return SphereDistance(position, start, radius.x);
+        case BrushShape::Ellipsoid: return EllipsoidDistance(position, start, radius);
+        case BrushShape::Cylinder:  return CylinderDistance(position, start, end, radius.x);
+        case BrushShape::Capsule:   return CapsuleDistance(position, start, end, radius.x);
+        case BrushShape::Cone:      return ConeDistance(position, start, end, radius.x);
+    }
+    return 1.0f;
+}
+
+glm::ivec3 VoxelBrush::GetMin() const {
+    glm::vec3 extent = shape == BrushShape::Ellipsoid ? radius : glm::vec3(radius.x);
+    glm::vec3 low = shape == BrushShape::Sphere || shape == BrushShape::Ellipsoid ? start : glm::min(start, end);
+    return glm::ivec3(glm::floor(low - extent - 0.5f));
+}
+
+glm::ivec3 VoxelBrush::GetMax() const {
+    glm::vec3 extent = shape == BrushShape::Ellipsoid ? radius : glm::vec3(radius.x);
+    glm::vec3 high = shape == BrushShape::Sphere || shape == BrushShape::Ellipsoid ? start : glm::max(start, end);
+    return glm::ivec3(glm::floor(high + extent - 0.5f));
+}
\ No newline at end of file
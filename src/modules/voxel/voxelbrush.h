@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "glm/vec3.hpp"
+
+#include "voxel.h"
+
+enum class BrushShape {
+    Sphere,    // centered on start with radius.x
+    Ellipsoid, // centered on start with per axis radius
+    Cylinder,  // capped, axis from start to end with radius.x
+    Capsule,   // segment from start to end inflated by radius.x
+    Cone       // base disc of radius.x at start, apex at end
+};
+
+enum class BrushMode {
+    Fill,  // writes the brush voxel everywhere inside
+    Carve, // clears everything inside to air
+    Paint  // recolors the solid voxels inside, air stays air
+};
+
+// An analytic edit shape in world voxel space. Voxels are sampled at their centers (position + 0.5).
+struct VoxelBrush {
+    BrushShape shape = BrushShape::Sphere;
+    BrushMode mode = BrushMode::Fill;
+    glm::vec3 start{};
+    glm::vec3 end{};
+    glm::vec3 radius{1.0f};
+    Voxel voxel{};
+
+    // Signed distance to the surface, negative inside. Outside it never overestimates the true distance,
+    // so a box whose center is further away than its half diagonal is fully outside.
+    float Distance(glm::vec3 position) const;
+
+    // inclusive voxel bounds of everything the brush can touch
+    glm::ivec3 GetMin(void) const;
+    glm::ivec3 GetMax(void) const;
+};
\ No newline at end of file
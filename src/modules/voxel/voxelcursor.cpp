@@ -0,0 +1,89 @@
+#include "voxelcursor.h"
+
+// bit shift that turns a chunk local coordinate into the child cell of a node at the given depth
+static constexpr uint32_t ChildShift(size_t depth) {
+    return CONTREE_NODE_SHIFT * (CONTREE_MAX_DEPTH - 1 - depth);
+}
+
+VoxelCursor::VoxelCursor(VoxelManager &manager, glm::ivec3 position) : manager(manager) {
+    Seek(position);
+}
+
+void VoxelCursor::Seek(glm::ivec3 position) {
+    this->position = position;
+    chunk_position = manager.GetChunkPosition(position);
+    local_position = position - chunk_position * glm::ivec3(CHUNK_WIDTH);
+    chunk = manager.GetChunkIndex(chunk_position);
+    edit_generation = manager.edit_generation;
+    valid = true;
+
+    path.clear();
+    if (chunk == nullptr) {
+        voxel = VOXEL_EMPTY;
+        return;
+    }
+    if (chunk->flags & CHUNK_FLAG_BRICK) { // no path, bricks are read directly
+        voxel = manager.GetVoxel(chunk, local_position);
+        return;
+    }
+    path.push(chunk->contree_node);
+    Descend();
+}
+
+void VoxelCursor::Move(uint8_t axis, int32_t direction) {
+    if (!valid || edit_generation != manager.edit_generation) {
+        glm::ivec3 next = position;
+        next[axis] += direction;
+        Seek(next);
+        return;
+    }
+
+    uint32_t old_local = local_position[axis];
+    uint32_t local = old_local + (uint32_t)direction;
+    position[axis] += direction;
+
+    if (local >= CHUNK_WIDTH) { // left the chunk (unsigned wrap covers -1), the cached path is useless
+        Seek(position);
+        return;
+    }
+
+    local_position[axis] = local;
+    if (path.empty()) {
+        if (chunk != nullptr) voxel = manager.GetVoxel(chunk, local_position);
+        return;
+    }
+
+    // the node at depth d still contains the cursor if no coordinate bit above its cell width changed
+    uint32_t changed = old_local ^ local;
+    while (path.size() > 1 && (changed >> ChildShift(path.size() - 2)) != 0) {
+        path.pop();
+    }
+    Descend();
+}
+
+Voxel VoxelCursor::Get() {
+    if (!valid || edit_generation != manager.edit_generation) Seek(position);
+    return voxel;
+}
+
+void VoxelCursor::Set(Voxel voxel) {
+    if (chunk == nullptr) return;
+    manager.SetVoxel(chunk, local_position, voxel);
+    valid = false;
+}
+
+void VoxelCursor::Descend() {
+    while (true) {
+        size_t depth = path.size() - 1;
+        uint32_t shift = ChildShift(depth);
+        glm::uvec3 cell = (local_position >> shift) & glm::uvec3(CONTREE_NODE_WIDTH - 1);
+
+        ContreeNode &node = *path.top();
+        size_t index = node.GetIndex(cell);
+        if (node.IsVoxel(index) || depth + 1 >= CONTREE_MAX_DEPTH) {
+            voxel = node.GetVoxel(index);
+            return;
+        }
+        path.push(node.GetPtr(index));
+    }
+}
\ No newline at end of file
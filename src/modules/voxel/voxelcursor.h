@@ -0,0 +1,40 @@
+#pragma once
+
+#include "voxelmanager.h"
+
+#include "fixedstack/fixedstack.hpp"
+
+// Walks the world one voxel at a time. The current chunk and the contree path down to the
+// current voxel are cached, so moving to a neighbour only re-descends below the lowest node
+// that contains both positions (bricked chunks keep no path). Any edit through the VoxelManager
+// invalidates the cache.
+class VoxelCursor {
+    public:
+        VoxelCursor(VoxelManager &manager, glm::ivec3 position);
+
+        void Seek(glm::ivec3 position);
+        void Move(uint8_t axis, int32_t direction); // steps the cursor by +-1 along axis (0 = x, 1 = y, 2 = z)
+
+        void MoveX(int32_t direction) { Move(0, direction); }
+        void MoveY(int32_t direction) { Move(1, direction); }
+        void MoveZ(int32_t direction) { Move(2, direction); }
+
+        Voxel Get(void);
+        void Set(Voxel voxel);
+
+        glm::ivec3 GetPosition(void) const { return position; }
+    private:
+        void Descend(void);
+
+        VoxelManager &manager;
+
+        glm::ivec3 position{};
+        glm::ivec3 chunk_position{};
+        glm::uvec3 local_position{};
+        Relptr<AllocatedChunksBase> chunk{};
+
+        FixedStack<ContreeNode*, CONTREE_MAX_DEPTH> path; // path[0] is the chunk root, the top holds the voxel. only valid for edit_generation
+        Voxel voxel{};
+        uint32_t edit_generation = 0;
+        bool valid = false;
+};
\ No newline at end of file
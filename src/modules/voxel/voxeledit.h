@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+#include "glm/vec3.hpp"
+#include "glm/common.hpp"
+
+#include "voxel.h"
+
+enum class VoxelEditShape : uint32_t {
+    Box,   // every voxel of [min, max]
+    Sphere // voxel centers within radius of center, the same test as a BrushShape::Sphere brush
+};
+
+// A compact edit command, what VoxelManager::QueueEdit takes. The renderer applies it on the GPU right away and the
+// VoxelManager replays it into the contrees later. Mirrors VoxelEdit in voxeledit.slang.
+struct VoxelEdit {
+    glm::ivec3 min{}; // inclusive voxel bounds of everything the edit can touch
+    VoxelEditShape shape = VoxelEditShape::Box;
+    glm::ivec3 max{};
+    Voxel voxel{};    // what ends up inside, VOXEL_EMPTY carves
+    glm::vec3 center{};
+    float radius = 0.0f;
+
+    static VoxelEdit Box(glm::ivec3 a, glm::ivec3 b, Voxel voxel) {
+        VoxelEdit edit;
+        edit.min = glm::min(a, b);
+        edit.max = glm::max(a, b);
+        edit.voxel = voxel;
+        return edit;
+    }
+
+    static VoxelEdit Point(glm::ivec3 position, Voxel voxel) {
+        return Box(position, position, voxel);
+    }
+
+    static VoxelEdit Sphere(glm::vec3 center, float radius, Voxel voxel) {
+        VoxelEdit edit;
+        edit.shape = VoxelEditShape::Sphere;
+        edit.min = glm::ivec3(glm::floor(center - radius));
+        edit.max = glm::ivec3(glm::floor(center + radius));
+        edit.voxel = voxel;
+        edit.center = center;
+        edit.radius = radius;
+        return edit;
+    }
+};
\ No newline at end of file
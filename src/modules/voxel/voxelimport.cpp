@@ -0,0 +1,405 @@
+#include "voxelimport.h"
+
+#include <cctype>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+
+#include "glm/vec2.hpp"
+#include "glm/common.hpp"
+
+#include "parallelfor/parallelfor.hpp"
+
+static constexpr uint32_t NODE_CHILD_COUNT = CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+static constexpr size_t CHUNK_VOLUME = size_t(CHUNK_WIDTH) * CHUNK_WIDTH * CHUNK_WIDTH;
+static constexpr uint32_t VOX_MAX_SIZE = 256; // XYZI coordinates are bytes
+
+static glm::uvec3 ChildPosition(uint32_t index) {
+    return glm::uvec3(
+        index % CONTREE_NODE_WIDTH,
+        (index / CONTREE_NODE_WIDTH) % CONTREE_NODE_WIDTH,
+        index / (CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH)
+    );
+}
+
+static size_t DenseIndex(glm::uvec3 position) {
+    return position.x + position.y * CHUNK_WIDTH + position.z * CHUNK_WIDTH * CHUNK_WIDTH;
+}
+
+// writes the voxels of a subtree into a dense chunk block
+static void ExtractDense(ContreeNode &node, uint32_t child_width, glm::uvec3 node_position, Voxel *dense) {
+    for (uint32_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        glm::uvec3 child = node_position + ChildPosition(i) * child_width;
+        if (!node.IsVoxel(i)) {
+            ExtractDense(*node.GetPtr(i), child_width / CONTREE_NODE_WIDTH, child, dense);
+            continue;
+        }
+        Voxel voxel = node.GetVoxel(i);
+        for (uint32_t z = child.z; z < child.z + child_width; z++)
+            for (uint32_t y = child.y; y < child.y + child_width; y++)
+                std::fill_n(dense + DenseIndex(glm::uvec3(child.x, y, z)), child_width, voxel);
+    }
+}
+
+// Builds the node covering [position, position + width) of a dense block. Non uniform children are appended to nodes
+// before their parent and pointed at by their index in nodes, uniform ones are folded into the parent slot.
+static ContreeNode BuildDenseNode(const Voxel *dense, glm::uvec3 position, uint32_t width, std::vector<ContreeNode> &nodes) {
+    ContreeNode node{};
+    uint32_t child_width = width / CONTREE_NODE_WIDTH;
+    uint32_t i = 0;
+    glm::uvec3 c;
+    for (c.z = 0; c.z < CONTREE_NODE_WIDTH; c.z++) {
+        for (c.y = 0; c.y < CONTREE_NODE_WIDTH; c.y++) {
+            for (c.x = 0; c.x < CONTREE_NODE_WIDTH; c.x++, i++) {
+                glm::uvec3 child = position + c * child_width;
+                if (child_width == 1) {
+                    node.SetVoxel(i, dense[DenseIndex(child)]);
+                    continue;
+                }
+                ContreeNode child_node = BuildDenseNode(dense, child, child_width, nodes);
+                if (child_node.IsUniform()) {
+                    node.SetVoxel(i, child_node.GetVoxel(0));
+                } else {
+                    nodes.push_back(child_node);
+                    node.SetPtr(i, static_cast<uint32_t>(nodes.size() - 1));
+                }
+            }
+        }
+    }
+    return node;
+}
+
+struct ChunkImport {
+    glm::ivec3 position{};
+    bool uniform = false; // the whole chunk becomes voxel, no dense pass needed
+    Voxel voxel{};
+};
+
+// Allocates the missing chunks, then rasterizes and builds the rest in batches on worker threads. Building only reads
+// contree_data, the splice into it runs on this thread between batches.
+static void ImportChunks(VoxelManager &manager, const std::vector<ChunkImport> &chunks, const std::function<void(size_t chunk, Voxel *dense)> &rasterize) {
+    std::vector<bool> fresh(chunks.size(), false);
+    bool allocated = false;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (manager.GetChunkIndex(chunks[i].position) != POINTER_EMPTY) continue;
+        manager.AllocateChunk(chunks[i].position);
+        fresh[i] = true;
+        allocated = true;
+    }
+    if (allocated) manager.GenerateChunkOccupancyMap();
+
+    struct ChunkBuild {
+        Relptr<AllocatedChunksBase> chunk{};
+        ContreeNode root{};
+        std::vector<ContreeNode> nodes{};
+    };
+
+    size_t workers = ParallelWorkerCount(chunks.size());
+    size_t batch_size = workers * 8; // bounds the detached nodes held between splices
+    std::vector<std::vector<Voxel>> dense(workers);
+    std::vector<ChunkBuild> builds(batch_size);
+
+    for (size_t first = 0; first < chunks.size(); first += batch_size) {
+        size_t count = std::min(batch_size, chunks.size() - first);
+        ParallelFor(count, [&](size_t i, size_t worker) {
+            const ChunkImport &chunk = chunks[first + i];
+            ChunkBuild &build = builds[i];
+            build.chunk = manager.GetChunkIndex(chunk.position);
+            build.nodes.clear();
+            build.root = ContreeNode{};
+
+            if (chunk.uniform) {
+                for (uint32_t c = 0; c < NODE_CHILD_COUNT; c++) build.root.SetVoxel(c, chunk.voxel);
+                return;
+            }
+
+            std::vector<Voxel> &block = dense[worker];
+            block.resize(CHUNK_VOLUME);
+            if (fresh[first + i]) std::fill(block.begin(), block.end(), VOXEL_EMPTY);
+            else ExtractDense(*build.chunk->contree_node, CHUNK_WIDTH / CONTREE_NODE_WIDTH, glm::uvec3(0), block.data());
+
+            rasterize(first + i, block.data());
+            build.root = BuildDenseNode(block.data(), glm::uvec3(0), CHUNK_WIDTH, build.nodes);
+        });
+
+        for (size_t i = 0; i < count; i++) {
+            manager.ReplaceChunkContree(builds[i].chunk, builds[i].root, builds[i].nodes);
+        }
+    }
+}
+
+void ImportDenseChunks(VoxelManager &manager, std::span<const glm::ivec3> positions, const Voxel *voxels) {
+    std::vector<ChunkImport> chunks(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) chunks[i].position = positions[i];
+
+    ImportChunks(manager, chunks, [voxels](size_t chunk, Voxel *dense) {
+        const Voxel *block = voxels + chunk * CHUNK_VOLUME;
+        for (size_t i = 0; i < CHUNK_VOLUME; i++) {
+            if (block[i] != VOXEL_EMPTY) dense[i] = block[i];
+        }
+    });
+}
+
+static bool ReadFile(const std::string &path, std::vector<uint8_t> &data) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    std::streamsize size = file.tellg();
+    if (size < 0) return false;
+    data.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), size));
+}
+
+static uint32_t ReadU32(const uint8_t *p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static Voxel VoxColor(uint8_t r, uint8_t g, uint8_t b) {
+    Voxel voxel{};
+    voxel.set_rgb(r >> 3, g >> 3, b >> 3);
+    voxel.set_solid(true);
+    return voxel;
+}
+
+// MagicaVoxel's built in palette for files without an RGBA chunk: a 6 level color cube counting down from white,
+// followed by 10 step red, green, blue and gray ramps
+static void DefaultVoxPalette(Voxel *palette) {
+    static constexpr uint8_t ramp[10] = {0xEE, 0xDD, 0xBB, 0xAA, 0x88, 0x77, 0x55, 0x44, 0x22, 0x11};
+    for (uint32_t i = 0; i < 255; i++) {
+        if (i < 215) {
+            palette[i] = VoxColor((5 - i / 36) * 0x33, (5 - (i / 6) % 6) * 0x33, (5 - i % 6) * 0x33);
+            continue;
+        }
+        uint32_t channel = (i - 215) / 10;
+        uint8_t level = ramp[(i - 215) % 10];
+        palette[i] = VoxColor(
+            channel == 0 || channel == 3 ? level : 0,
+            channel == 1 || channel == 3 ? level : 0,
+            channel == 2 || channel == 3 ? level : 0
+        );
+    }
+    palette[255] = VoxColor(0, 0, 0);
+}
+
+bool ImportVox(VoxelManager &manager, const std::string &path, glm::ivec3 position) {
+    std::vector<uint8_t> file;
+    if (!ReadFile(path, file)) return false;
+    if (file.size() < 8 || std::memcmp(file.data(), "VOX ", 4) != 0) return false;
+
+    struct VoxModel {
+        glm::ivec3 size{};
+        const uint8_t *voxels = nullptr; // x, y, z, color index per voxel
+        uint32_t count = 0;
+    };
+    std::vector<VoxModel> models;
+
+    Voxel palette[256];
+    DefaultVoxPalette(palette);
+
+    // only MAIN has children and every other chunk we read is a leaf, so the children can be walked in file order
+    size_t offset = 8;
+    while (offset + 12 <= file.size()) {
+        const uint8_t *chunk = file.data() + offset;
+        size_t content = ReadU32(chunk + 4);
+        size_t children = ReadU32(chunk + 8);
+        const uint8_t *data = chunk + 12;
+        if (offset + 12 + content > file.size()) return false;
+
+        if (std::memcmp(chunk, "MAIN", 4) == 0) {
+            offset += 12 + content;
+            continue;
+        }
+
+        if (std::memcmp(chunk, "SIZE", 4) == 0 && content >= 12) {
+            glm::uvec3 size(ReadU32(data), ReadU32(data + 4), ReadU32(data + 8));
+            if (size.x == 0 || size.y == 0 || size.z == 0) return false;
+            if (size.x > VOX_MAX_SIZE || size.y > VOX_MAX_SIZE || size.z > VOX_MAX_SIZE) return false;
+            models.push_back({glm::ivec3(size)});
+        } else if (std::memcmp(chunk, "XYZI", 4) == 0 && content >= 4 && !models.empty()) {
+            uint32_t count = ReadU32(data);
+            if (4 + size_t(count) * 4 > content) return false;
+            models.back().voxels = data + 4;
+            models.back().count = count;
+        } else if (std::memcmp(chunk, "RGBA", 4) == 0 && content >= 256 * 4) {
+            // color index c (1-255) lives at entry c - 1
+            for (uint32_t i = 0; i < 256; i++) palette[i] = VoxColor(data[i * 4], data[i * 4 + 1], data[i * 4 + 2]);
+        }
+        offset += 12 + content + children;
+    }
+    if (models.empty()) return false;
+
+    // z up in the file, y up here, the file's y becomes -z so the model is rotated rather than mirrored
+    glm::ivec3 world_min = position;
+    glm::ivec3 world_max = position;
+    int32_t x_offset = 0;
+    for (const VoxModel &model : models) {
+        world_max = glm::max(world_max, position + glm::ivec3(x_offset + model.size.x, model.size.z, model.size.y) - 1);
+        x_offset += model.size.x + 1;
+    }
+
+    glm::ivec3 chunk_min = manager.GetChunkPosition(world_min);
+    glm::ivec3 chunk_grid = manager.GetChunkPosition(world_max) - chunk_min + 1;
+
+    // sort every voxel into its chunk: chunk index in the high half, local position and color index in the low half
+    std::vector<uint64_t> keys;
+    x_offset = 0;
+    for (const VoxModel &model : models) {
+        for (uint32_t i = 0; i < model.count; i++) {
+            const uint8_t *v = model.voxels + i * 4;
+            if (v[3] == 0) continue;
+            if (v[0] >= model.size.x || v[1] >= model.size.y || v[2] >= model.size.z) continue; // outside its own model
+            glm::ivec3 world = position + glm::ivec3(x_offset + v[0], v[2], model.size.y - 1 - v[1]);
+            glm::ivec3 chunk = manager.GetChunkPosition(world);
+            glm::uvec3 local = glm::uvec3(world - chunk * glm::ivec3(CHUNK_WIDTH));
+            glm::ivec3 grid = chunk - chunk_min;
+            uint64_t chunk_index = grid.x + grid.y * chunk_grid.x + grid.z * chunk_grid.x * chunk_grid.y;
+            keys.push_back((chunk_index << 32) | (uint64_t(DenseIndex(local)) << 8) | v[3]);
+        }
+        x_offset += model.size.x + 1;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<ChunkImport> chunks;
+    std::vector<size_t> ranges; // chunks[i] owns keys[ranges[i], ranges[i + 1])
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i > 0 && (keys[i] >> 32) == (keys[i - 1] >> 32)) continue;
+        uint32_t chunk_index = static_cast<uint32_t>(keys[i] >> 32);
+        glm::ivec3 grid(chunk_index % chunk_grid.x, (chunk_index / chunk_grid.x) % chunk_grid.y, chunk_index / (chunk_grid.x * chunk_grid.y));
+        chunks.push_back({chunk_min + grid});
+        ranges.push_back(i);
+    }
+    ranges.push_back(keys.size());
+
+    ImportChunks(manager, chunks, [&](size_t chunk, Voxel *dense) {
+        for (size_t i = ranges[chunk]; i < ranges[chunk + 1]; i++) {
+            uint64_t key = keys[i];
+            dense[(key >> 8) & 0xFFFFFF] = palette[(key & 0xFF) - 1];
+        }
+    });
+    return true;
+}
+
+// reads RAW or PGM samples into heights, returns false on a malformed file
+static bool ReadHeightmap(const std::string &path, uint32_t raw_width, std::vector<uint16_t> &heights, uint32_t &width, uint32_t &depth) {
+    std::vector<uint8_t> file;
+    if (!ReadFile(path, file)) return false;
+
+    if (file.size() >= 2 && file[0] == 'P' && file[1] == '5') {
+        // header is four whitespace separated fields (magic, width, height, maxval) with # comments allowed between them
+        size_t offset = 2;
+        uint32_t fields[3] = {};
+        for (uint32_t f = 0; f < 3; f++) {
+            while (offset < file.size()) {
+                if (file[offset] == '#') {
+                    while (offset < file.size() && file[offset] != '\n') offset++;
+                } else if (std::isspace(file[offset])) {
+                    offset++;
+                } else {
+                    break;
+                }
+            }
+            if (offset >= file.size() || !std::isdigit(file[offset])) return false;
+            while (offset < file.size() && std::isdigit(file[offset])) fields[f] = fields[f] * 10 + (file[offset++] - '0');
+        }
+        offset++; // single whitespace before the samples
+
+        width = fields[0];
+        depth = fields[1];
+        uint32_t maxval = fields[2];
+        size_t sample_size = maxval > 255 ? 2 : 1;
+        if (maxval == 0 || file.size() < offset + size_t(width) * depth * sample_size) return false;
+
+        heights.resize(size_t(width) * depth);
+        const uint8_t *samples = file.data() + offset;
+        for (size_t i = 0; i < heights.size(); i++) {
+            // PGM is big endian, scale narrower maxvals up to the full 16 bit range
+            uint32_t sample = sample_size == 2 ? (uint32_t(samples[i * 2]) << 8) | samples[i * 2 + 1] : samples[i];
+            heights[i] = static_cast<uint16_t>(sample * 65535u / maxval);
+        }
+        return true;
+    }
+
+    size_t count = file.size() / 2;
+    width = raw_width != 0 ? raw_width : static_cast<uint32_t>(std::sqrt(double(count)));
+    if (width == 0) return false;
+    depth = static_cast<uint32_t>(count / width);
+
+    heights.resize(size_t(width) * depth);
+    for (size_t i = 0; i < heights.size(); i++) heights[i] = static_cast<uint16_t>(file[i * 2] | (file[i * 2 + 1] << 8));
+    return true;
+}
+
+bool ImportHeightmap(VoxelManager &manager, const std::string &path, glm::ivec3 position, const HeightmapImport &settings) {
+    std::vector<uint16_t> samples;
+    uint32_t width, depth;
+    if (!ReadHeightmap(path, settings.width, samples, width, depth)) return false;
+    if (width == 0 || depth == 0) return false;
+
+    // column heights in voxels
+    std::vector<uint32_t> heights(samples.size());
+    uint32_t max_height = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        heights[i] = static_cast<uint32_t>(samples[i] * settings.height_scale);
+        max_height = std::max(max_height, heights[i]);
+    }
+    if (max_height == 0) return true;
+
+    glm::ivec3 chunk_min = manager.GetChunkPosition(position);
+    glm::ivec3 chunk_max = manager.GetChunkPosition(position + glm::ivec3(width - 1, max_height - 1, depth - 1));
+
+    std::vector<ChunkImport> chunks;
+    for (int32_t cz = chunk_min.z; cz <= chunk_max.z; cz++) {
+        for (int32_t cx = chunk_min.x; cx <= chunk_max.x; cx++) {
+            // the footprint of this chunk column in heightmap samples
+            glm::ivec2 low = glm::max(glm::ivec2(cx, cz) * int32_t(CHUNK_WIDTH) - glm::ivec2(position.x, position.z), glm::ivec2(0));
+            glm::ivec2 high = glm::min(glm::ivec2(cx + 1, cz + 1) * int32_t(CHUNK_WIDTH) - glm::ivec2(position.x, position.z), glm::ivec2(width, depth));
+            bool covered = (high - low) == glm::ivec2(CHUNK_WIDTH);
+
+            uint32_t column_min = UINT32_MAX;
+            uint32_t column_max = 0;
+            for (int32_t z = low.y; z < high.y; z++) {
+                for (int32_t x = low.x; x < high.x; x++) {
+                    uint32_t h = heights[x + size_t(z) * width];
+                    column_min = std::min(column_min, h);
+                    column_max = std::max(column_max, h);
+                }
+            }
+            if (column_max == 0) continue;
+
+            // chunks that lie entirely in the rock layer of a fully covered column skip the dense pass
+            int32_t rock_top = position.y + int32_t(column_min) - 1 - int32_t(settings.soil_depth); // exclusive
+            int32_t layer_end = manager.GetChunkPosition(glm::ivec3(0, position.y + int32_t(column_max) - 1, 0)).y;
+            for (int32_t cy = chunk_min.y; cy <= layer_end; cy++) {
+                bool rock = covered && (cy + 1) * int32_t(CHUNK_WIDTH) <= rock_top && cy * int32_t(CHUNK_WIDTH) >= position.y;
+                chunks.push_back({glm::ivec3(cx, cy, cz), rock, settings.rock});
+            }
+        }
+    }
+
+    ImportChunks(manager, chunks, [&](size_t chunk, Voxel *dense) {
+        glm::ivec3 origin = chunks[chunk].position * glm::ivec3(CHUNK_WIDTH);
+        for (uint32_t lz = 0; lz < CHUNK_WIDTH; lz++) {
+            int32_t z = origin.z + lz - position.z;
+            if (z < 0 || z >= int32_t(depth)) continue;
+            for (uint32_t lx = 0; lx < CHUNK_WIDTH; lx++) {
+                int32_t x = origin.x + lx - position.x;
+                if (x < 0 || x >= int32_t(width)) continue;
+
+                // the column is rock below rock_end, soil up to top and the surface voxel at top, clipped to the chunk
+                int32_t top = position.y + int32_t(heights[x + size_t(z) * width]) - 1 - origin.y;
+                int32_t bottom = std::max(position.y - origin.y, 0);
+                int32_t end = std::min(top, int32_t(CHUNK_WIDTH));
+                int32_t rock_end = std::clamp(top - int32_t(settings.soil_depth), bottom, std::max(end, bottom));
+
+                Voxel *column = dense + DenseIndex(glm::uvec3(lx, 0, lz));
+                int32_t y = bottom;
+                for (; y < rock_end; y++) column[y * CHUNK_WIDTH] = settings.rock;
+                for (; y < end; y++) column[y * CHUNK_WIDTH] = settings.soil;
+                if (top >= bottom && top < int32_t(CHUNK_WIDTH)) column[top * CHUNK_WIDTH] = settings.surface;
+            }
+        }
+    });
+    return true;
+}
\ No newline at end of file
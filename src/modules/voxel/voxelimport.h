@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <span>
+
+#include "voxelmanager.h"
+
+struct HeightmapImport {
+    float height_scale = 1.0f / 256.0f; // voxels per heightmap unit, the default maps 65535 to 256 voxels
+    uint32_t width = 0;                 // RAW only, 0 means square and derived from the file size
+    uint32_t soil_depth = 3;            // voxels of soil under the surface voxel before rock starts
+    Voxel surface{};
+    Voxel soil{};
+    Voxel rock{};
+};
+
+// Both importers rasterize their input into a dense 64^3 block per chunk and build that chunk's contree on worker
+// threads, the finished trees are then spliced into the world. Missing chunks are allocated and the occupancy map is
+// regenerated. Air in the input never overwrites existing voxels. They return false if the file can't be read.
+
+// MagicaVoxel .vox, z up in the file becomes y up in the world. Multiple models are laid out side by side along x.
+bool ImportVox(VoxelManager &manager, const std::string &path, glm::ivec3 position);
+
+// 16 bit heightmaps, either headerless little endian RAW or binary PGM (P5, 8 or 16 bit). Sample (x, z) becomes a column
+// at position + (x, 0, z).
+bool ImportHeightmap(VoxelManager &manager, const std::string &path, glm::ivec3 position, const HeightmapImport &settings);
+
+// Dense 64^3 blocks produced elsewhere (TerrainGenerator reads them back from the GPU). voxels holds one block per
+// position in brick order, x fastest.
+void ImportDenseChunks(VoxelManager &manager, std::span<const glm::ivec3> positions, const Voxel *voxels);
\ No newline at end of file
@@ -1,10 +1,15 @@
 #include "voxelmanager.h"
+#include "worldfile.h"
 
 #include "glm/common.hpp"
 #include <unordered_set>
 #include <sstream>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 
 #include "fixedstack/fixedstack.hpp"
+#include "parallelfor/parallelfor.hpp"
 
 void VoxelManager::Init() {
     ContreeDataBase::set_base(contree_data);
@@ -12,10 +17,26 @@ void VoxelManager::Init() {
     contree_data.reserve(10);
     free_contree_indicies.reserve(10);
     allocated_chunks.reserve(10);
+    materials.push_back({});
 }
 
-void VoxelManager::Process() {
+static constexpr std::chrono::microseconds EDIT_REPLAY_BUDGET{2000}; // per frame, the GPU shows the rest meanwhile
+static constexpr std::chrono::microseconds CANONICALIZE_BUDGET{1000}; // per frame, a started slice always finishes
 
+void VoxelManager::Process() {
+    auto start = std::chrono::steady_clock::now();
+    while (!pending_edits.empty() && std::chrono::steady_clock::now() - start < EDIT_REPLAY_BUDGET) {
+        ApplyEdit(pending_edits.front());
+        pending_edits.pop_front();
+    }
+    // edits leave their chunks dirty, fold a few every frame so the list drains and the summaries tighten again.
+    // a slice is one chunk per worker, roughly half a millisecond
+    start = std::chrono::steady_clock::now();
+    while (!dirty_chunks.empty() && std::chrono::steady_clock::now() - start < CANONICALIZE_BUDGET) {
+        Canonicalize(ParallelWorkerCount(dirty_chunks.size()));
+    }
+    // carves mark the columns they may have lowered, rescanned here before the list builds up
+    if (!stale_surface_columns.empty()) UpdateSurfaceHeights();
 }
 
 void VoxelManager::Shutdown() {
@@ -25,6 +46,15 @@ void VoxelManager::Shutdown() {
     allocated_chunks.reserve(0);
 }
 
+uint16_t VoxelManager::AddMaterial(const Material &material) {
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (materials[i] == material) return static_cast<uint16_t>(i);
+    }
+    assert(materials.size() <= UINT16_MAX);
+    materials.push_back(material);
+    return static_cast<uint16_t>(materials.size() - 1);
+}
+
 Relptr<ContreeDataBase> VoxelManager::AllocateContreeNode() {
     uint32_t data_index;
     if (free_contree_indicies.empty()) {
@@ -36,9 +66,65 @@ Relptr<ContreeDataBase> VoxelManager::AllocateContreeNode() {
     }
     contree_data[data_index] = {};
     contree_data[data_index].isVoxelMask = CONTREE_VOXEL_MASK_FULL; // default to all empty voxels
+    upload_nodes.Mark(data_index);
     return data_index;
 }
 
+// Reserves count consecutive nodes and returns the first, their contents are left for the caller. Freed nodes are reused
+// when enough of them are consecutive, either anywhere in the free list or at the end of contree_data where the run
+// can be extended, otherwise the run is appended.
+uint32_t VoxelManager::AllocateContreeRun(size_t count) {
+    if (count == 0) return static_cast<uint32_t>(contree_data.size());
+
+    // kept highest index first, so back() stays the lowest free index. only the part freed since the last call is unsorted
+    auto sorted_end = std::is_sorted_until(free_contree_indicies.begin(), free_contree_indicies.end(), std::greater<uint32_t>());
+    std::sort(sorted_end, free_contree_indicies.end(), std::greater<uint32_t>());
+    std::inplace_merge(free_contree_indicies.begin(), sorted_end, free_contree_indicies.end(), std::greater<uint32_t>());
+
+    // the lowest run that is long enough, scanned from the back
+    size_t run = 0;
+    for (size_t i = free_contree_indicies.size(); i-- > 0;) {
+        run = (run > 0 && free_contree_indicies[i] == free_contree_indicies[i + 1] + 1) ? run + 1 : 1;
+        if (run < count) continue;
+        uint32_t base = free_contree_indicies[i + count - 1];
+        free_contree_indicies.erase(free_contree_indicies.begin() + i, free_contree_indicies.begin() + i + count);
+        return base;
+    }
+
+    // free nodes at the very end only need the rest appended
+    size_t tail = 0;
+    while (tail < free_contree_indicies.size() && free_contree_indicies[tail] == contree_data.size() - 1 - tail) tail++;
+    free_contree_indicies.erase(free_contree_indicies.begin(), free_contree_indicies.begin() + tail);
+    uint32_t base = static_cast<uint32_t>(contree_data.size() - tail);
+    contree_data.resize(size_t(base) + count, ContreeNode{});
+    return base;
+}
+
+void VoxelManager::MarkSubtreeUpload(Relptr<ContreeDataBase> node) {
+    upload_nodes.Mark(node.offset);
+    if (node->isVoxelMask == CONTREE_VOXEL_MASK_FULL) return;
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        if (!node->IsVoxel(i)) MarkSubtreeUpload(node->GetPtr(i));
+    }
+}
+
+void VoxelManager::MarkChunkUpload(uint32_t chunk) {
+    if (chunk >= allocated_chunks.size()) return;
+    upload_chunks.Mark(chunk);
+    upload_distances.Mark(size_t(chunk) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t), size_t(chunk + 1) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t));
+    Relptr<ContreeDataBase> root = allocated_chunks[chunk].contree_node;
+    if (root.offset < contree_data.size()) MarkSubtreeUpload(root);
+}
+
+// after the world was rebuilt wholesale (loading, compaction)
+void VoxelManager::MarkWorldUpload() {
+    upload_nodes.MarkAll(contree_data.size());
+    upload_chunks.MarkAll(allocated_chunks.size());
+    upload_distances.MarkAll(chunk_distances.size() / sizeof(uint32_t));
+    upload_bricks.MarkAll(brick_data.size() / 2);
+    upload_directory = true;
+}
+
 void VoxelManager::FreeContreeNode(Relptr<ContreeDataBase> root) {
     if (root == nullptr) return;
 
@@ -55,19 +141,598 @@ void VoxelManager::FreeContreeNode(Relptr<ContreeDataBase> root) {
     free_contree_indicies.push_back(root.offset);
 }
 
+// Recomputes the lod voxel and coverage of a node from its children, whose summaries have to be current already.
+// Each child slot is 1/64th of the volume: a solid voxel counts fully, a child node by its own coverage. The color is
+// the coverage weighted average and the material is taken from the child contributing the most.
+static void UpdateNodeLod(ContreeNode &node) {
+    float weight = 0.0f;
+    glm::vec3 color(0.0f);
+    uint16_t material = MATERIAL_DEFAULT;
+    float material_weight = 0.0f;
+
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        Voxel child;
+        float child_weight;
+        if (node.IsVoxel(i)) {
+            child = node.voxel_data[i];
+            child_weight = child.solid() ? 1.0f : 0.0f;
+        } else {
+            const ContreeNode &child_node = *node.child_nodes[i];
+            child = child_node.lod_voxel;
+            child_weight = child_node.coverage;
+        }
+        if (child_weight <= 0.0f) continue;
+
+        weight += child_weight;
+        color += glm::vec3(child.r(), child.g(), child.b()) * child_weight;
+        if (child_weight > material_weight) {
+            material = child.material();
+            material_weight = child_weight;
+        }
+    }
+
+    node.coverage = weight / float(CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH);
+    node.lod_voxel = VOXEL_EMPTY;
+    if (weight <= 0.0f) return;
+
+    color = color / weight + 0.5f;
+    node.lod_voxel.set_rgb(uint8_t(color.r), uint8_t(color.g), uint8_t(color.b));
+    node.lod_voxel.set_material(material);
+    node.lod_voxel.set_solid(node.coverage >= 0.5f);
+}
+
+// refreshes a whole subtree, for nodes that were written without going through the edit functions
+static void UpdateSubtreeLod(ContreeNode &node) {
+    if (node.isVoxelMask != CONTREE_VOXEL_MASK_FULL) {
+        for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+            if (!node.IsVoxel(i)) UpdateSubtreeLod(*node.child_nodes[i]);
+        }
+    }
+    UpdateNodeLod(node);
+}
+
+// grows min/max over the solid voxels below node, subtrees already inside the bounds are not entered
+static void SolidBounds(const ContreeNode &node, glm::uvec3 position, uint32_t width, glm::uvec3 &min, glm::uvec3 &max) {
+    uint32_t child_width = width / CONTREE_NODE_WIDTH;
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        if (!node.IsOccupied(i)) continue;
+        glm::uvec3 child = position + glm::uvec3(i % CONTREE_NODE_WIDTH, (i / CONTREE_NODE_WIDTH) % CONTREE_NODE_WIDTH, i / (CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH)) * child_width;
+        glm::uvec3 child_max = child + glm::uvec3(child_width - 1);
+        if (glm::all(glm::greaterThanEqual(child, min)) && glm::all(glm::lessThanEqual(child_max, max))) continue;
+
+        if ((node.isVoxelMask >> i) & 1ULL) {
+            min = glm::min(min, child);
+            max = glm::max(max, child_max);
+        } else {
+            SolidBounds(*node.child_nodes[i], child, child_width, min, max);
+        }
+    }
+}
+
+// recomputes the empty/full flags and the tight solid bounds of a chunk
+static void UpdateChunkSummary(Chunk &chunk) {
+    const ContreeNode &root = *chunk.contree_node;
+    chunk.flags &= ~(CHUNK_FLAG_EMPTY | CHUNK_FLAG_FULL);
+    chunk.solid_min = 0;
+    chunk.solid_max = 0;
+    if (root.occupancyMask == 0) {
+        chunk.flags |= CHUNK_FLAG_EMPTY;
+        return;
+    }
+    if (root.isVoxelMask == CONTREE_VOXEL_MASK_FULL && root.occupancyMask == CONTREE_VOXEL_MASK_FULL) chunk.flags |= CHUNK_FLAG_FULL;
+
+    glm::uvec3 min(CHUNK_WIDTH);
+    glm::uvec3 max(0);
+    SolidBounds(root, glm::uvec3(0), CHUNK_WIDTH, min, max);
+    chunk.solid_min = PackChunkLocal(min);
+    chunk.solid_max = PackChunkLocal(max);
+}
+
+// Rebuilds the distance field of a chunk. A cell may hold solid voxels when its bit in the occupancy mask of the root's
+// child is set, or the root's child is a solid voxel, bricked chunks look at the voxels of the cell. A forward and a
+// backward chamfer pass over the 26 neighbours then give the exact Chebyshev distance. The passes run on a copy with a
+// border of far cells so they need no bounds checks.
+static bool BrickCellSolid(const uint16_t *brick, glm::uvec3 cell) {
+    glm::uvec3 origin = cell * CHUNK_DISTANCE_CELL_WIDTH;
+    for (uint32_t z = 0; z < CHUNK_DISTANCE_CELL_WIDTH; z++)
+        for (uint32_t y = 0; y < CHUNK_DISTANCE_CELL_WIDTH; y++)
+            for (uint32_t x = 0; x < CHUNK_DISTANCE_CELL_WIDTH; x++)
+                if (Voxel{brick[BrickIndex(origin + glm::uvec3(x, y, z))]}.solid()) return true;
+    return false;
+}
+
+static void BuildChunkDistances(const Chunk &chunk, const uint16_t *brick, uint8_t *distances) {
+    constexpr int32_t WIDTH = CHUNK_DISTANCE_WIDTH;
+    constexpr int32_t PADDED = WIDTH + 2;
+    uint8_t padded[PADDED * PADDED * PADDED];
+    std::fill_n(padded, PADDED * PADDED * PADDED, CHUNK_DISTANCE_FAR);
+
+    const ContreeNode &root = *chunk.contree_node;
+    for (uint32_t z = 0; z < WIDTH; z++) {
+        for (uint32_t y = 0; y < WIDTH; y++) {
+            for (uint32_t x = 0; x < WIDTH; x++) {
+                glm::uvec3 top = glm::uvec3(x, y, z) / uint32_t(CONTREE_NODE_WIDTH);
+                glm::uvec3 sub = glm::uvec3(x, y, z) % uint32_t(CONTREE_NODE_WIDTH);
+                uint32_t i = top.x + top.y * CONTREE_NODE_WIDTH + top.z * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+                uint32_t j = sub.x + sub.y * CONTREE_NODE_WIDTH + sub.z * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+                bool occupied = (root.occupancyMask >> i) & 1ULL;
+                if (occupied && !((root.isVoxelMask >> i) & 1ULL)) occupied = (root.child_nodes[i]->occupancyMask >> j) & 1ULL;
+                if (brick != nullptr) occupied = BrickCellSolid(brick, glm::uvec3(x, y, z));
+                if (occupied) padded[(x + 1) + (y + 1) * PADDED + (z + 1) * PADDED * PADDED] = 0;
+            }
+        }
+    }
+
+    // the 13 neighbours a forward pass has already visited, the backward pass mirrors them
+    int32_t neighbours[13];
+    uint32_t count = 0;
+    for (int32_t dz = -1; dz <= 0; dz++)
+        for (int32_t dy = -1; dy <= 1; dy++)
+            for (int32_t dx = -1; dx <= 1; dx++)
+                if (dz < 0 || dy < 0 || (dy == 0 && dx < 0)) neighbours[count++] = dx + dy * PADDED + dz * PADDED * PADDED;
+
+    auto relax = [&](int32_t index, int32_t direction) {
+        uint32_t distance = padded[index];
+        for (int32_t offset : neighbours) distance = glm::min<uint32_t>(distance, padded[index + offset * direction] + 1u);
+        padded[index] = static_cast<uint8_t>(distance);
+    };
+    for (int32_t z = 1; z <= WIDTH; z++)
+        for (int32_t y = 1; y <= WIDTH; y++)
+            for (int32_t x = 1; x <= WIDTH; x++) relax(x + y * PADDED + z * PADDED * PADDED, 1);
+    for (int32_t z = WIDTH; z >= 1; z--)
+        for (int32_t y = WIDTH; y >= 1; y--)
+            for (int32_t x = WIDTH; x >= 1; x--) relax(x + y * PADDED + z * PADDED * PADDED, -1);
+
+    for (int32_t z = 0; z < WIDTH; z++)
+        for (int32_t y = 0; y < WIDTH; y++)
+            std::copy_n(padded + 1 + (y + 1) * PADDED + (z + 1) * PADDED * PADDED, WIDTH, distances + y * WIDTH + z * WIDTH * WIDTH);
+}
+
+// Keeps the summary of a chunk conservative after an edit of the world box [start, end] without walking the tree:
+// writing solid voxels grows the bounds, writing air means the chunk may no longer be full. Canonicalize tightens it.
+void VoxelManager::TouchChunkSummary(Relptr<AllocatedChunksBase> chunk, glm::ivec3 start_position, glm::ivec3 end_position, bool solid) {
+    glm::ivec3 origin = chunk->position * glm::ivec3(CHUNK_WIDTH);
+    upload_chunks.Mark(chunk.offset);
+    if (!solid) {
+        chunk->flags &= ~CHUNK_FLAG_FULL;
+        return;
+    }
+
+    bool was_empty = chunk->flags & CHUNK_FLAG_EMPTY;
+    glm::ivec3 low = glm::max(start_position - origin, glm::ivec3(0));
+    glm::ivec3 high = glm::min(end_position - origin, glm::ivec3(CHUNK_WIDTH - 1));
+    chunk->GrowSolidBounds(low, high);
+    LowerChunkDistances(chunk, low, high);
+
+    if (was_empty) MarkChunkPyramid(chunk->position);
+}
+
+// Zeroes the distance cells of the chunk local box [low, high] and lowers the cells around them, spreading out from the
+// box only as far as distances actually drop. Writing into cells that are already solid costs nothing.
+void VoxelManager::LowerChunkDistances(Relptr<AllocatedChunksBase> chunk, glm::uvec3 low, glm::uvec3 high) {
+    constexpr int32_t WIDTH = CHUNK_DISTANCE_WIDTH;
+    uint8_t *distances = chunk_distances.data() + size_t(chunk.offset) * CHUNK_DISTANCE_CELLS;
+    low /= CHUNK_DISTANCE_CELL_WIDTH;
+    high /= CHUNK_DISTANCE_CELL_WIDTH;
+
+    std::vector<glm::ivec3> queue;
+    for (uint32_t z = low.z; z <= high.z; z++) {
+        for (uint32_t y = low.y; y <= high.y; y++) {
+            for (uint32_t x = low.x; x <= high.x; x++) {
+                uint8_t &distance = distances[x + y * WIDTH + z * WIDTH * WIDTH];
+                if (distance == 0) continue;
+                distance = 0;
+                upload_distances.Mark((&distance - chunk_distances.data()) / sizeof(uint32_t));
+                queue.push_back(glm::ivec3(x, y, z));
+            }
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        glm::ivec3 cell = queue[head];
+        uint8_t next = distances[cell.x + cell.y * WIDTH + cell.z * WIDTH * WIDTH] + 1;
+        for (int32_t dz = -1; dz <= 1; dz++) {
+            for (int32_t dy = -1; dy <= 1; dy++) {
+                for (int32_t dx = -1; dx <= 1; dx++) {
+                    glm::ivec3 n = cell + glm::ivec3(dx, dy, dz);
+                    if (glm::any(glm::lessThan(n, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(n, glm::ivec3(WIDTH)))) continue;
+                    uint8_t &distance = distances[n.x + n.y * WIDTH + n.z * WIDTH * WIDTH];
+                    if (distance <= next) continue;
+                    distance = next;
+                    upload_distances.Mark((&distance - chunk_distances.data()) / sizeof(uint32_t));
+                    queue.push_back(n);
+                }
+            }
+        }
+    }
+}
+
+void VoxelManager::GenerateChunkDistances() {
+    chunk_distances.resize(allocated_chunks.size() * CHUNK_DISTANCE_CELLS);
+    ParallelFor(allocated_chunks.size(), [&](size_t i, size_t) {
+        BuildChunkDistances(allocated_chunks[i], GetBrick(allocated_chunks[i]), chunk_distances.data() + i * CHUNK_DISTANCE_CELLS);
+    });
+    upload_distances.MarkAll(chunk_distances.size() / sizeof(uint32_t));
+}
+
+uint8_t VoxelManager::GetChunkDistance(Relptr<AllocatedChunksBase> chunk, glm::uvec3 position) const {
+    glm::uvec3 cell = position / CHUNK_DISTANCE_CELL_WIDTH;
+    return chunk_distances[size_t(chunk.offset) * CHUNK_DISTANCE_CELLS + cell.x + cell.y * CHUNK_DISTANCE_WIDTH + cell.z * CHUNK_DISTANCE_WIDTH * CHUNK_DISTANCE_WIDTH];
+}
+
+static constexpr int32_t SURFACE_HEIGHT_STALE = INT32_MAX; // an edit may have lowered the column, rescanned on demand
+
+// highest solid voxel at or below top in the column (x, z) of a node of the given width, -1 when there is none
+static int32_t NodeColumnTop(const ContreeNode &node, uint32_t x, uint32_t z, uint32_t top, uint32_t width) {
+    uint32_t child_width = width / CONTREE_NODE_WIDTH;
+    uint32_t cx = x / child_width;
+    uint32_t cz = z / child_width;
+    for (int32_t cy = top / child_width; cy >= 0; cy--) {
+        size_t index = cx + cy * CONTREE_NODE_WIDTH + cz * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+        if (!node.IsOccupied(index)) continue;
+        uint32_t base = cy * child_width;
+        uint32_t child_top = glm::min(top - base, child_width - 1);
+        if ((node.isVoxelMask >> index) & 1ULL) return base + child_top;
+        int32_t y = NodeColumnTop(*node.child_nodes[index], x % child_width, z % child_width, child_top, child_width);
+        if (y >= 0) return base + y;
+    }
+    return -1;
+}
+
+// walks the directory column holding the world column (x, z) top down, chunk summaries rule out most chunks unread
+int32_t VoxelManager::ScanSurfaceHeight(int32_t x, int32_t z) {
+    glm::ivec3 size = glm::ivec3(chunk_occupancy.size);
+    glm::ivec3 local = glm::ivec3(x, 0, z) - chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+    glm::ivec3 chunk_column = local / glm::ivec3(CHUNK_WIDTH);
+    glm::uvec3 column = glm::uvec3(local - chunk_column * glm::ivec3(CHUNK_WIDTH));
+
+    for (int32_t cy = size.y - 1; cy >= 0; cy--) {
+        Relptr<AllocatedChunksBase> chunk = chunk_occupancy.chunks[chunk_column.x + cy * size.x + chunk_column.z * size.x * size.y];
+        if (chunk == nullptr || (chunk->flags & CHUNK_FLAG_EMPTY)) continue;
+        glm::uvec3 low = UnpackChunkLocal(chunk->solid_min);
+        glm::uvec3 high = UnpackChunkLocal(chunk->solid_max);
+        if (column.x < low.x || column.x > high.x || column.z < low.z || column.z > high.z) continue;
+
+        int32_t top = -1;
+        if (const uint16_t *brick = GetBrick(*chunk)) {
+            for (int32_t y = high.y; y >= int32_t(low.y) && top < 0; y--) {
+                if (Voxel{brick[BrickIndex(glm::uvec3(column.x, y, column.z))]}.solid()) top = y;
+            }
+        } else {
+            top = NodeColumnTop(*chunk->contree_node, column.x, column.z, high.y, CHUNK_WIDTH);
+        }
+        if (top >= 0) return chunk->position.y * CHUNK_WIDTH + top;
+    }
+    return SURFACE_HEIGHT_NONE;
+}
+
+void VoxelManager::GenerateSurfaceHeights() {
+    stale_surface_columns.clear();
+    surface_heights.clear();
+    if (chunk_occupancy.chunks == nullptr) return;
+
+    uint32_t width = chunk_occupancy.size.x * CHUNK_WIDTH;
+    uint32_t depth = chunk_occupancy.size.z * CHUNK_WIDTH;
+    glm::ivec3 origin = chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+    surface_heights.resize(size_t(width) * depth);
+    ParallelFor(depth, [&](size_t z, size_t) {
+        for (uint32_t x = 0; x < width; x++) surface_heights[x + z * width] = ScanSurfaceHeight(origin.x + x, origin.z + int32_t(z));
+    });
+}
+
+int32_t VoxelManager::GetSurfaceHeight(int32_t x, int32_t z) {
+    glm::ivec3 local = glm::ivec3(x, 0, z) - chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+    uint32_t width = chunk_occupancy.size.x * CHUNK_WIDTH;
+    if (surface_heights.empty() || local.x < 0 || local.z < 0 || uint32_t(local.x) >= width || uint32_t(local.z) >= chunk_occupancy.size.z * CHUNK_WIDTH) {
+        return SURFACE_HEIGHT_NONE;
+    }
+
+    int32_t &height = surface_heights[local.x + size_t(local.z) * width];
+    if (height == SURFACE_HEIGHT_STALE) height = ScanSurfaceHeight(x, z);
+    return height;
+}
+
+void VoxelManager::UpdateSurfaceHeights() {
+    uint32_t width = chunk_occupancy.size.x * CHUNK_WIDTH;
+    glm::ivec3 origin = chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+    std::sort(stale_surface_columns.begin(), stale_surface_columns.end());
+    stale_surface_columns.erase(std::unique(stale_surface_columns.begin(), stale_surface_columns.end()), stale_surface_columns.end());
+    for (uint32_t index : stale_surface_columns) {
+        int32_t &height = surface_heights[index];
+        if (height == SURFACE_HEIGHT_STALE) height = ScanSurfaceHeight(origin.x + int32_t(index % width), origin.z + int32_t(index / width));
+    }
+    stale_surface_columns.clear();
+}
+
+// Keeps the heights of the columns through the world box [start, end] (clipped to the chunk) exact or marked: writing
+// solid voxels raises them to the top of the box, writing air marks the columns whose top it may have removed.
+void VoxelManager::TouchSurfaceHeights(Relptr<AllocatedChunksBase> chunk, glm::ivec3 start_position, glm::ivec3 end_position, bool solid) {
+    glm::ivec3 local = chunk->position - chunk_occupancy.position;
+    if (surface_heights.empty() || glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(glm::uvec3(local), chunk_occupancy.size))) return;
+
+    glm::ivec3 origin = chunk->position * glm::ivec3(CHUNK_WIDTH);
+    glm::ivec3 low = glm::max(start_position, origin);
+    glm::ivec3 high = glm::min(end_position, origin + glm::ivec3(CHUNK_WIDTH - 1));
+    glm::ivec3 map_origin = chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+    uint32_t width = chunk_occupancy.size.x * CHUNK_WIDTH;
+
+    for (int32_t z = low.z; z <= high.z; z++) {
+        for (int32_t x = low.x; x <= high.x; x++) {
+            uint32_t index = uint32_t(x - map_origin.x) + uint32_t(z - map_origin.z) * width;
+            int32_t &height = surface_heights[index];
+            if (solid) {
+                height = glm::max(height, high.y); // a stale column stays stale
+            } else if (height >= low.y && height <= high.y) {
+                height = SURFACE_HEIGHT_STALE;
+                stale_surface_columns.push_back(index);
+            }
+        }
+    }
+}
+
+// sets the bit of a chunk that may hold solid voxels now on every pyramid level
+void VoxelManager::MarkChunkPyramid(glm::ivec3 chunk_position) {
+    glm::ivec3 local = chunk_position - chunk_occupancy.position;
+    if (chunk_pyramid.empty() || glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(glm::uvec3(local), chunk_occupancy.size))) return;
+    for (uint32_t level = 0; level < chunk_occupancy.pyramid_levels; level++) {
+        glm::uvec3 level_size = ChunkPyramidLevelSize(chunk_occupancy.size, level);
+        glm::uvec3 cell = glm::uvec3(local) >> (CHUNK_PYRAMID_SHIFT * level);
+        uint32_t bit = cell.x + cell.y * level_size.x + cell.z * level_size.x * level_size.y;
+        chunk_pyramid[chunk_pyramid_offsets[level] + bit / 32] |= 1u << (bit % 32);
+    }
+    upload_directory = true;
+}
+
 Relptr<AllocatedChunksBase> VoxelManager::AllocateChunk(const glm::ivec3 position) {
+    edit_generation++;
     allocated_chunks.push_back({
         position,
-        //CHUNK_FLAG_EXISTS,
-        AllocateContreeNode()
+        AllocateContreeNode(),
+        CHUNK_FLAG_EXISTS | CHUNK_FLAG_EMPTY
     });
+    chunk_distances.resize(allocated_chunks.size() * CHUNK_DISTANCE_CELLS, CHUNK_DISTANCE_FAR);
+    upload_chunks.Mark(allocated_chunks.size() - 1);
+    upload_distances.Mark((allocated_chunks.size() - 1) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t), chunk_distances.size() / sizeof(uint32_t));
     return allocated_chunks.size() - 1;
 }
 
 void VoxelManager::FreeChunk(Relptr<AllocatedChunksBase> chunk) {
+    edit_generation++;
+    chunk_generation++; // the last chunk takes its index
+    FreeBrick(chunk);
     FreeContreeNode(chunk->contree_node);
+    uint32_t moved = static_cast<uint32_t>(allocated_chunks.size() - 1);
+    std::erase(dirty_chunks, chunk.offset);
+    std::replace(dirty_chunks.begin(), dirty_chunks.end(), moved, chunk.offset);
     allocated_chunks[chunk.offset] = allocated_chunks.back();
     allocated_chunks.pop_back();
+    std::copy_n(chunk_distances.end() - CHUNK_DISTANCE_CELLS, CHUNK_DISTANCE_CELLS, chunk_distances.begin() + size_t(chunk.offset) * CHUNK_DISTANCE_CELLS);
+    chunk_distances.resize(allocated_chunks.size() * CHUNK_DISTANCE_CELLS);
+    upload_chunks.Mark(chunk.offset);
+    upload_distances.Mark(size_t(chunk.offset) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t), size_t(chunk.offset + 1) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t));
+}
+
+const uint16_t *VoxelManager::GetBrick(const Chunk &chunk) const {
+    if (!(chunk.flags & CHUNK_FLAG_BRICK)) return nullptr;
+    return brick_data.data() + size_t(chunk.brick) * CHUNK_BRICK_VOXELS;
+}
+
+// a tree of more nodes than a brick holds bytes is bricked, a brick whose tree would need UNBRICK_NODES or fewer is not
+static constexpr size_t BRICK_NODES = CHUNK_BRICK_VOXELS * sizeof(uint16_t) / sizeof(ContreeNode);
+static constexpr size_t UNBRICK_NODES = BRICK_NODES / 2;
+
+// nodes below node, or 0 when a voxel does not fit in a brick
+static size_t BrickCandidateNodes(const ContreeNode &node) {
+    size_t count = 1;
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        if ((node.isVoxelMask >> i) & 1ULL) {
+            if (node.voxel_data[i].material() != MATERIAL_DEFAULT) return 0;
+            continue;
+        }
+        size_t child = BrickCandidateNodes(*node.child_nodes[i]);
+        if (child == 0) return 0;
+        count += child;
+    }
+    return count;
+}
+
+static void WriteBrick(const ContreeNode &node, glm::uvec3 position, uint32_t width, uint16_t *brick) {
+    uint32_t child_width = width / CONTREE_NODE_WIDTH;
+    uint32_t i = 0;
+    glm::uvec3 c;
+    for (c.z = 0; c.z < CONTREE_NODE_WIDTH; c.z++) {
+        for (c.y = 0; c.y < CONTREE_NODE_WIDTH; c.y++) {
+            for (c.x = 0; c.x < CONTREE_NODE_WIDTH; c.x++, i++) {
+                glm::uvec3 child = position + c * child_width;
+                if (!((node.isVoxelMask >> i) & 1ULL)) {
+                    WriteBrick(*node.child_nodes[i], child, child_width, brick);
+                    continue;
+                }
+                uint16_t voxel = static_cast<uint16_t>(node.voxel_data[i].data);
+                for (uint32_t z = child.z; z < child.z + child_width; z++)
+                    for (uint32_t y = child.y; y < child.y + child_width; y++)
+                        std::fill_n(brick + BrickIndex(glm::uvec3(child.x, y, z)), child_width, voxel);
+            }
+        }
+    }
+}
+
+// The root keeps one coarse voxel per child (the child's lod) so it stays a valid node, the voxels go to the brick.
+// Summaries and the distance field describe the same voxels and stay as they are.
+void VoxelManager::BrickChunk(Relptr<AllocatedChunksBase> chunk) {
+    if (chunk->flags & CHUNK_FLAG_BRICK) return;
+    edit_generation++;
+
+    uint32_t slot;
+    if (free_bricks.empty()) {
+        slot = static_cast<uint32_t>(brick_data.size() / CHUNK_BRICK_VOXELS);
+        brick_data.resize(brick_data.size() + CHUNK_BRICK_VOXELS);
+    } else {
+        slot = free_bricks.back();
+        free_bricks.pop_back();
+    }
+
+    Relptr<ContreeDataBase> root = chunk->contree_node;
+    WriteBrick(*root, glm::uvec3(0), CHUNK_WIDTH, brick_data.data() + size_t(slot) * CHUNK_BRICK_VOXELS);
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        if (root->IsVoxel(i)) continue;
+        Relptr<ContreeDataBase> child = root->GetPtr(i);
+        Voxel lod = child->lod_voxel;
+        FreeContreeNode(child);
+        root->SetVoxel(i, lod);
+    }
+    chunk->brick = slot;
+    chunk->flags |= CHUNK_FLAG_BRICK;
+    upload_nodes.Mark(root.offset);
+    upload_chunks.Mark(chunk.offset);
+    upload_bricks.Mark(size_t(slot) * CHUNK_BRICK_VOXELS / 2, size_t(slot + 1) * CHUNK_BRICK_VOXELS / 2);
+}
+
+static bool BrickBlockUniform(const uint16_t *brick, glm::uvec3 position, uint32_t width) {
+    uint16_t first = brick[BrickIndex(position)];
+    for (uint32_t z = position.z; z < position.z + width; z++)
+        for (uint32_t y = position.y; y < position.y + width; y++)
+            for (uint32_t x = position.x; x < position.x + width; x++)
+                if (brick[BrickIndex(glm::uvec3(x, y, z))] != first) return false;
+    return true;
+}
+
+// nodes below the brick block at position once it is a tree again (UnbrickNode), counting stops past limit
+static size_t BrickSubtreeNodes(const uint16_t *brick, glm::uvec3 position, uint32_t width, size_t limit) {
+    size_t count = 0;
+    uint32_t child_width = width / CONTREE_NODE_WIDTH;
+    glm::uvec3 c;
+    for (c.z = 0; c.z < CONTREE_NODE_WIDTH; c.z++) {
+        for (c.y = 0; c.y < CONTREE_NODE_WIDTH; c.y++) {
+            for (c.x = 0; c.x < CONTREE_NODE_WIDTH; c.x++) {
+                glm::uvec3 child = position + c * child_width;
+                if (BrickBlockUniform(brick, child, child_width)) continue;
+                count += 1 + BrickSubtreeNodes(brick, child, child_width, limit);
+                if (count > limit) return count;
+            }
+        }
+    }
+    return count;
+}
+
+// the lod the tree would hold for the brick block at position, the solid voxels' average color (see UpdateNodeLod).
+// grows min/max over the solid voxels and adds them to count
+static Voxel BrickBlockLod(const uint16_t *brick, glm::uvec3 position, uint32_t width, glm::uvec3 &min, glm::uvec3 &max, size_t &count) {
+    uint32_t solid = 0;
+    glm::vec3 color(0.0f);
+    for (uint32_t z = position.z; z < position.z + width; z++) {
+        for (uint32_t y = position.y; y < position.y + width; y++) {
+            for (uint32_t x = position.x; x < position.x + width; x++) {
+                Voxel voxel{brick[BrickIndex(glm::uvec3(x, y, z))]};
+                if (!voxel.solid()) continue;
+                solid++;
+                color += glm::vec3(voxel.r(), voxel.g(), voxel.b());
+                min = glm::min(min, glm::uvec3(x, y, z));
+                max = glm::max(max, glm::uvec3(x, y, z));
+            }
+        }
+    }
+    count += solid;
+    if (solid == 0) return VOXEL_EMPTY;
+
+    color = color / float(solid) + 0.5f;
+    Voxel lod = VOXEL_EMPTY;
+    lod.set_rgb(uint8_t(color.r), uint8_t(color.g), uint8_t(color.b));
+    lod.set_solid(solid * 2 >= width * width * width);
+    return lod;
+}
+
+// The root's coarse voxels and the summary of a bricked chunk after its brick was edited, from the voxels of the brick.
+// Touches nothing outside the chunk, so chunks can run in parallel.
+static void UpdateBrickChunk(Chunk &chunk, const uint16_t *brick) {
+    ContreeNode &root = *chunk.contree_node;
+    glm::uvec3 min(CHUNK_WIDTH);
+    glm::uvec3 max(0);
+    size_t solid = 0;
+    uint32_t child_width = CHUNK_WIDTH / CONTREE_NODE_WIDTH;
+    uint32_t i = 0;
+    glm::uvec3 c;
+    for (c.z = 0; c.z < CONTREE_NODE_WIDTH; c.z++)
+        for (c.y = 0; c.y < CONTREE_NODE_WIDTH; c.y++)
+            for (c.x = 0; c.x < CONTREE_NODE_WIDTH; c.x++, i++)
+                root.SetVoxel(i, BrickBlockLod(brick, c * child_width, child_width, min, max, solid));
+    UpdateNodeLod(root);
+
+    chunk.flags &= ~(CHUNK_FLAG_EMPTY | CHUNK_FLAG_FULL);
+    chunk.solid_min = 0;
+    chunk.solid_max = 0;
+    if (solid == 0) {
+        chunk.flags |= CHUNK_FLAG_EMPTY;
+        return;
+    }
+    if (solid == CHUNK_BRICK_VOXELS) chunk.flags |= CHUNK_FLAG_FULL;
+    chunk.solid_min = PackChunkLocal(min);
+    chunk.solid_max = PackChunkLocal(max);
+}
+
+// Fills slot index of node with the brick block at position: a voxel when the block is uniform, otherwise a new node
+// built the same way one level down.
+void VoxelManager::UnbrickNode(Relptr<ContreeDataBase> node, size_t index, const uint16_t *brick, glm::uvec3 position, uint32_t width) {
+    upload_nodes.Mark(node.offset);
+    if (BrickBlockUniform(brick, position, width)) {
+        node->SetVoxel(index, Voxel{brick[BrickIndex(position)]});
+        return;
+    }
+
+    Relptr<ContreeDataBase> child = AllocateContreeNode();
+    uint32_t child_width = width / CONTREE_NODE_WIDTH;
+    uint32_t i = 0;
+    glm::uvec3 c;
+    for (c.z = 0; c.z < CONTREE_NODE_WIDTH; c.z++)
+        for (c.y = 0; c.y < CONTREE_NODE_WIDTH; c.y++)
+            for (c.x = 0; c.x < CONTREE_NODE_WIDTH; c.x++, i++)
+                UnbrickNode(child, i, brick, position + c * child_width, child_width);
+    UpdateNodeLod(*child);
+    node->SetPtr(index, child);
+}
+
+void VoxelManager::UnbrickChunk(Relptr<AllocatedChunksBase> chunk) {
+    if (!(chunk->flags & CHUNK_FLAG_BRICK)) return;
+    edit_generation++;
+
+    const uint16_t *brick = GetBrick(*chunk);
+    Relptr<ContreeDataBase> root = chunk->contree_node;
+    uint32_t child_width = CHUNK_WIDTH / CONTREE_NODE_WIDTH;
+    uint32_t i = 0;
+    glm::uvec3 c;
+    for (c.z = 0; c.z < CONTREE_NODE_WIDTH; c.z++)
+        for (c.y = 0; c.y < CONTREE_NODE_WIDTH; c.y++)
+            for (c.x = 0; c.x < CONTREE_NODE_WIDTH; c.x++, i++)
+                UnbrickNode(root, i, brick, c * child_width, child_width);
+    UpdateNodeLod(*root);
+    FreeBrick(chunk);
+}
+
+// The brick an edit writing voxel can go straight into. Voxels a brick can't hold turn the chunk back into a tree,
+// nullptr then and for chunks that are not bricked.
+uint16_t *VoxelManager::EditBrick(Relptr<AllocatedChunksBase> chunk, Voxel voxel) {
+    if (!(chunk->flags & CHUNK_FLAG_BRICK)) return nullptr;
+    if (voxel.material() != MATERIAL_DEFAULT) {
+        UnbrickChunk(chunk);
+        return nullptr;
+    }
+    return brick_data.data() + size_t(chunk->brick) * CHUNK_BRICK_VOXELS;
+}
+
+// marks the brick words of the chunk local box [low, high], a range per row
+void VoxelManager::MarkBrickUpload(Relptr<AllocatedChunksBase> chunk, glm::uvec3 low, glm::uvec3 high) {
+    size_t base = size_t(chunk->brick) * CHUNK_BRICK_VOXELS;
+    for (uint32_t z = low.z; z <= high.z; z++)
+        for (uint32_t y = low.y; y <= high.y; y++)
+            upload_bricks.Mark((base + BrickIndex(glm::uvec3(low.x, y, z))) / 2, (base + BrickIndex(glm::uvec3(high.x, y, z))) / 2 + 1);
+}
+
+void VoxelManager::FreeBrick(Relptr<AllocatedChunksBase> chunk) {
+    if (!(chunk->flags & CHUNK_FLAG_BRICK)) return;
+    free_bricks.push_back(chunk->brick);
+    chunk->brick = POINTER_EMPTY;
+    chunk->flags &= ~CHUNK_FLAG_BRICK;
+    upload_chunks.Mark(chunk.offset);
 }
 
 uint32_t VoxelManager::GetChunkIndex(const glm::ivec3 position) {
@@ -120,12 +785,23 @@ void VoxelManager::SetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 positi
     };
     FixedStack<NodeStack, CONTREE_MAX_DEPTH> stack;
 
+    edit_generation++;
+
+    glm::ivec3 world_position = chunk->position * glm::ivec3(CHUNK_WIDTH) + glm::ivec3(position);
+    TouchChunkSummary(chunk, world_position, world_position, voxel.solid());
+    TouchSurfaceHeights(chunk, world_position, world_position, voxel.solid());
+
+    if (uint16_t *brick = EditBrick(chunk, voxel)) {
+        brick[BrickIndex(position)] = static_cast<uint16_t>(voxel.data);
+        MarkBrickUpload(chunk, position, position);
+        dirty_chunks.push_back(chunk.offset); // the root's coarse voxels and the summary, see Canonicalize
+        return;
+    }
+
     Relptr<ContreeDataBase> node = chunk->contree_node;
     
     glm::uvec3 chunk_width = glm::uvec3(CHUNK_WIDTH);
 
-    stack.push({node, 0});
-
     for (uint8_t depth = 0; depth < CONTREE_MAX_DEPTH - 1; depth++) { // depth - 1 because we dont need to allocate/check on the last layer we just want to set a voxel in it
         chunk_width /= CONTREE_NODE_WIDTH;
 
@@ -137,6 +813,7 @@ void VoxelManager::SetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 positi
         if (node->IsVoxel(child_node_index)) {
             Voxel child_node_voxel = node->GetVoxel(child_node_index);
             if (child_node_voxel == voxel) return;
+            upload_nodes.Mark(node.offset);
 
             Relptr<ContreeDataBase> new_node = AllocateContreeNode();
             node->SetPtr(child_node_index, new_node);
@@ -152,33 +829,37 @@ void VoxelManager::SetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 positi
 
     uint8_t child_node_index = node->GetIndex(position);
     node->SetVoxel(child_node_index, voxel);
+    UpdateNodeLod(*node);
+    upload_nodes.Mark(node.offset);
 
     ContreeNode* current_node = node;
 
+    // collapse uniform nodes and refresh the lod of every node on the path, bottom up
     while (stack.size() > 0) {
-        if (!current_node->IsUniform())
-            break;
-
-        Voxel voxel_value = current_node->GetVoxel(0);
-
         NodeStack parent_info = stack.pop();
 
         ContreeNode* parent_node = parent_info.node_index;
+        upload_nodes.Mark(parent_info.node_index.offset); // lod, and the slot when the child collapses
 
-        FreeContreeNode(parent_node->GetPtr(parent_info.child_index));
+        if (current_node->IsUniform()) {
+            Voxel voxel_value = current_node->GetVoxel(0);
+            FreeContreeNode(parent_node->GetPtr(parent_info.child_index));
+            parent_node->SetVoxel(parent_info.child_index, voxel_value);
+        }
 
-        parent_node->SetVoxel(parent_info.child_index, voxel_value);
+        UpdateNodeLod(*parent_node);
 
         current_node = parent_node;
     }
 }
 
 Voxel VoxelManager::GetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 position) {
+    if (const uint16_t *brick = GetBrick(*chunk)) return Voxel{brick[BrickIndex(position)]};
     Relptr<ContreeDataBase> node = chunk->contree_node;
     
     glm::uvec3 chunk_width = glm::uvec3(CHUNK_WIDTH);
     
-    for (uint8_t depth; depth < CONTREE_MAX_DEPTH; depth++) {
+    for (uint8_t depth = 0; depth < CONTREE_MAX_DEPTH; depth++) {
         chunk_width /= CONTREE_NODE_WIDTH;
 
         glm::uvec3 node_position = (position / chunk_width);
@@ -194,6 +875,120 @@ Voxel VoxelManager::GetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 posit
     return VOXEL_EMPTY;
 }
 
+#if defined(__GNUC__) || defined(__clang__)
+#define VOXEL_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define VOXEL_PREFETCH(address)
+#endif
+
+void VoxelManager::GetVoxels(std::span<const glm::ivec3> positions, std::span<Voxel> voxels) {
+    const size_t count = std::min(positions.size(), voxels.size());
+    if (count == 0 || chunk_occupancy.chunks == nullptr) {
+        std::fill(voxels.begin(), voxels.begin() + count, VOXEL_EMPTY);
+        return;
+    }
+
+    static_assert(CHUNK_WIDTH == 64, "GetVoxels packs local coordinates into 6 bits per axis");
+    constexpr uint32_t LOCAL_BITS = 6;
+    constexpr uint32_t LOCAL_MASK = CHUNK_WIDTH - 1;
+    constexpr uint32_t PREFETCH_DISTANCE = 16;
+
+    // structure of arrays so the index math below stays in plain loops the compiler can vectorize
+    std::vector<uint32_t> chunk_index(count);
+    std::vector<uint32_t> local(count);
+
+    const int32_t region_x = chunk_occupancy.position.x;
+    const int32_t region_y = chunk_occupancy.position.y;
+    const int32_t region_z = chunk_occupancy.position.z;
+    const uint32_t size_x = chunk_occupancy.size.x;
+    const uint32_t size_y = chunk_occupancy.size.y;
+    const uint32_t size_z = chunk_occupancy.size.z;
+    for (size_t i = 0; i < count; i++) {
+        const glm::ivec3 &p = positions[i];
+        // arithmetic shift floors negative positions, the unsigned compare rejects both sides of the region at once
+        uint32_t cx = (uint32_t)((p.x >> LOCAL_BITS) - region_x);
+        uint32_t cy = (uint32_t)((p.y >> LOCAL_BITS) - region_y);
+        uint32_t cz = (uint32_t)((p.z >> LOCAL_BITS) - region_z);
+        bool inside = cx < size_x && cy < size_y && cz < size_z;
+        chunk_index[i] = inside ? cx + cy * size_x + cz * size_x * size_y : POINTER_EMPTY;
+        local[i] =
+            ((uint32_t)p.x & LOCAL_MASK) |
+            (((uint32_t)p.y & LOCAL_MASK) << LOCAL_BITS) |
+            (((uint32_t)p.z & LOCAL_MASK) << (LOCAL_BITS * 2));
+    }
+
+    // bucket the queries by chunk (counting sort) so the first levels walk the nodes of one chunk together
+    const uint32_t bucket_count = static_cast<uint32_t>(allocated_chunks.size());
+    std::vector<uint32_t> bucket_start(bucket_count + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        if (chunk_index[i] != POINTER_EMPTY) chunk_index[i] = chunk_occupancy.chunks[chunk_index[i]].offset;
+        if (chunk_index[i] == POINTER_EMPTY) {
+            voxels[i] = VOXEL_EMPTY;
+            continue;
+        }
+        if (const uint16_t *brick = GetBrick(allocated_chunks[chunk_index[i]])) {
+            // bricks answer directly, the bit layout of local matches BrickIndex
+            voxels[i] = Voxel{brick[local[i]]};
+            chunk_index[i] = POINTER_EMPTY;
+            continue;
+        }
+        bucket_start[chunk_index[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < bucket_count; b++) bucket_start[b + 1] += bucket_start[b];
+
+    const uint32_t active_count = bucket_start[bucket_count];
+    std::vector<uint32_t> active(active_count); // query ids still descending, grouped by chunk
+    std::vector<uint32_t> node(active_count);   // node each active query sits in
+    std::vector<uint32_t> child(active_count);  // child slot of that node for the current level
+    for (size_t i = 0; i < count; i++) {
+        if (chunk_index[i] == POINTER_EMPTY) continue;
+        active[bucket_start[chunk_index[i]]++] = static_cast<uint32_t>(i);
+    }
+    for (uint32_t b = 0, a = 0; b < bucket_count; b++) {
+        uint32_t root = allocated_chunks[b].contree_node.offset;
+        for (; a < bucket_start[b]; a++) node[a] = root;
+    }
+
+    ContreeNode *nodes = contree_data.data();
+    uint32_t remaining = active_count;
+    for (uint8_t depth = 0; depth < CONTREE_MAX_DEPTH && remaining > 0; depth++) {
+        const uint32_t shift = CONTREE_NODE_SHIFT * (CONTREE_MAX_DEPTH - 1 - depth);
+        const bool last_level = depth + 1 == CONTREE_MAX_DEPTH;
+
+        // child index of every active query at this level: x | y << 2 | z << 4 pulled out of the packed local position
+        for (uint32_t a = 0; a < remaining; a++) {
+            uint32_t p = local[active[a]] >> shift;
+            child[a] =
+                (p & 0x3) |
+                ((p >> (LOCAL_BITS - 2)) & 0xC) |
+                ((p >> (LOCAL_BITS * 2 - 4)) & 0x30);
+        }
+
+        // branchless: every query writes its payload as a voxel and is kept only if the payload was a pointer,
+        // the ones kept are compacted to the front in order so the chunk grouping survives
+        uint32_t next = 0;
+        for (uint32_t a = 0; a < remaining; a++) {
+            if (a + PREFETCH_DISTANCE < remaining) {
+                const ContreeNode &ahead = nodes[node[a + PREFETCH_DISTANCE]];
+                VOXEL_PREFETCH(&ahead.isVoxelMask);
+                VOXEL_PREFETCH(&ahead.voxel_data[child[a + PREFETCH_DISTANCE]]);
+            }
+
+            const ContreeNode &n = nodes[node[a]];
+            uint32_t c = child[a];
+            uint32_t query = active[a];
+            uint32_t payload = n.voxel_data[c].data;
+            bool descend = !((n.isVoxelMask >> c) & 1ULL) && !last_level;
+
+            voxels[query].data = payload;
+            active[next] = query;
+            node[next] = payload;
+            next += descend;
+        }
+        remaining = next;
+    }
+}
+
 void VoxelManager::FillVoxels(glm::ivec3 start_position, glm::ivec3 end_position, Voxel voxel) {
     glm::ivec3 fill_start = glm::min(start_position, end_position);
     glm::ivec3 fill_end   = glm::max(start_position, end_position); // inclusive last voxel
@@ -206,7 +1001,20 @@ void VoxelManager::FillVoxels(glm::ivec3 start_position, glm::ivec3 end_position
             for (int32_t cz = chunk_start.z; cz < chunk_end.z; ++cz) {
                 Relptr<AllocatedChunksBase> c = GetChunkIndex(glm::ivec3(cx, cy, cz));
                 if (c == nullptr) continue;
-                FillVoxels(c->contree_node, 1, c->position * glm::ivec3(CHUNK_WIDTH), fill_start, fill_end, voxel);
+                if (uint16_t *brick = EditBrick(c, voxel)) {
+                    glm::ivec3 origin = c->position * glm::ivec3(CHUNK_WIDTH);
+                    glm::uvec3 low = glm::uvec3(glm::max(fill_start - origin, glm::ivec3(0)));
+                    glm::uvec3 high = glm::uvec3(glm::min(fill_end - origin, glm::ivec3(CHUNK_WIDTH - 1)));
+                    for (uint32_t z = low.z; z <= high.z; z++)
+                        for (uint32_t y = low.y; y <= high.y; y++)
+                            std::fill_n(brick + BrickIndex(glm::uvec3(low.x, y, z)), high.x - low.x + 1, static_cast<uint16_t>(voxel.data));
+                    MarkBrickUpload(c, low, high);
+                } else {
+                    FillVoxels(c->contree_node, 1, c->position * glm::ivec3(CHUNK_WIDTH), fill_start, fill_end, voxel);
+                }
+                TouchChunkSummary(c, fill_start, fill_end, voxel.solid());
+                TouchSurfaceHeights(c, fill_start, fill_end, voxel.solid());
+                dirty_chunks.push_back(c.offset);
             }
         }
     }
@@ -232,6 +1040,7 @@ bool FullyContains(glm::ivec3 outerMin, glm::ivec3 outerMax,
 
 // Sets every cell of a node to the same voxel, without further subdivision.
 void VoxelManager::FillNodeUniform(Relptr<ContreeDataBase> node, Voxel voxel) {
+    edit_generation++;
     glm::uvec3 i;
     for (i.x = 0; i.x < CONTREE_NODE_WIDTH; i.x++)
         for (i.y = 0; i.y < CONTREE_NODE_WIDTH; i.y++)
@@ -241,10 +1050,48 @@ void VoxelManager::FillNodeUniform(Relptr<ContreeDataBase> node, Voxel voxel) {
                 if (!node->IsVoxel(index)) FreeContreeNode(node->GetPtr(index));
                 node->SetVoxel(index, voxel);
             }
+    UpdateNodeLod(*node);
+    upload_nodes.Mark(node.offset);
+}
+
+void VoxelManager::ReplaceChunkContree(Relptr<AllocatedChunksBase> chunk, const ContreeNode &root, std::span<const ContreeNode> nodes) {
+    edit_generation++;
+    FreeBrick(chunk);
+    Relptr<ContreeDataBase> chunk_root = chunk->contree_node;
+    FillNodeUniform(chunk_root, VOXEL_EMPTY); // releases the old subtree, the root itself stays with the chunk
+
+    // the detached nodes stay in one block, so rebasing is a constant offset
+    uint32_t base = AllocateContreeRun(nodes.size());
+    auto rebase = [base](ContreeNode &node) {
+        if (node.isVoxelMask == CONTREE_VOXEL_MASK_FULL) return;
+        for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+            if (!node.IsVoxel(i)) node.child_nodes[i].offset += base;
+        }
+    };
+
+    std::copy(nodes.begin(), nodes.end(), contree_data.begin() + base);
+    for (size_t i = base; i < base + nodes.size(); i++) rebase(contree_data[i]);
+    upload_nodes.Mark(base, base + nodes.size());
+    upload_nodes.Mark(chunk_root.offset);
+    upload_chunks.Mark(chunk.offset);
+
+    *chunk_root = root;
+    rebase(*chunk_root);
+    UpdateSubtreeLod(*chunk_root);
+    UpdateChunkSummary(*chunk);
+    BuildChunkDistances(*chunk, nullptr, chunk_distances.data() + size_t(chunk.offset) * CHUNK_DISTANCE_CELLS);
+    upload_distances.Mark(size_t(chunk.offset) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t), size_t(chunk.offset + 1) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t));
+    if (!(chunk->flags & CHUNK_FLAG_EMPTY)) MarkChunkPyramid(chunk->position);
+
+    glm::ivec3 origin = chunk->position * glm::ivec3(CHUNK_WIDTH);
+    TouchSurfaceHeights(chunk, origin, origin + glm::ivec3(CHUNK_WIDTH - 1), true);
+    TouchSurfaceHeights(chunk, origin, origin + glm::ivec3(CHUNK_WIDTH - 1), false);
 }
 
 void VoxelManager::FillVoxels(Relptr<ContreeDataBase> node, uint8_t depth, glm::ivec3 node_position, glm::ivec3 start_position, glm::ivec3 end_position, Voxel voxel) {
     if (node == nullptr) return;
+    edit_generation++;
+    upload_nodes.Mark(node.offset);
     // FIX 3: allow execution at depth == CONTREE_MAX_DEPTH so the final level actually gets written
     if (depth > CONTREE_MAX_DEPTH) return;
 
@@ -286,13 +1133,304 @@ void VoxelManager::FillVoxels(Relptr<ContreeDataBase> node, uint8_t depth, glm::
             }
         }
     }
+    UpdateNodeLod(*node);
+}
+
+
+void VoxelManager::QueueEdit(VoxelEdit edit) {
+    if (!edit.voxel.solid()) edit.voxel = VOXEL_EMPTY; // a carve leaves air behind, like BrushMode::Carve
+    pending_edits.push_back(edit);
+}
+
+void VoxelManager::ApplyEdit(const VoxelEdit &edit) {
+    switch (edit.shape) {
+        case VoxelEditShape::Box:
+            FillVoxels(edit.min, edit.max, edit.voxel);
+            break;
+        case VoxelEditShape::Sphere: {
+            VoxelBrush brush;
+            brush.shape = BrushShape::Sphere;
+            brush.mode = edit.voxel.solid() ? BrushMode::Fill : BrushMode::Carve;
+            brush.start = edit.center;
+            brush.radius = glm::vec3(edit.radius);
+            brush.voxel = edit.voxel;
+            ApplyBrush(brush);
+            break;
+        }
+    }
+}
+
+void VoxelManager::ApplyBrush(const VoxelBrush &brush) {
+    glm::ivec3 chunk_start = GetChunkPosition(brush.GetMin());
+    glm::ivec3 chunk_end   = GetChunkPosition(brush.GetMax()) + 1;
+
+    edit_generation++;
+    for (int32_t cx = chunk_start.x; cx < chunk_end.x; ++cx) {
+        for (int32_t cy = chunk_start.y; cy < chunk_end.y; ++cy) {
+            for (int32_t cz = chunk_start.z; cz < chunk_end.z; ++cz) {
+                Relptr<AllocatedChunksBase> c = GetChunkIndex(glm::ivec3(cx, cy, cz));
+                if (c == nullptr) continue;
+                if (uint16_t *brick = EditBrick(c, brush.mode == BrushMode::Carve ? VOXEL_EMPTY : brush.voxel)) {
+                    ApplyBrush(c, brick, brush);
+                } else {
+                    ApplyBrush(c->contree_node, 1, c->position * glm::ivec3(CHUNK_WIDTH), brush);
+                }
+                if (brush.mode == BrushMode::Fill) TouchChunkSummary(c, brush.GetMin(), brush.GetMax(), brush.voxel.solid());
+                if (brush.mode == BrushMode::Carve) TouchChunkSummary(c, brush.GetMin(), brush.GetMax(), false);
+                // the shape fills only part of its box, so a fill may raise a column anywhere up to the top of the box
+                if (brush.mode == BrushMode::Fill && brush.voxel.solid()) TouchSurfaceHeights(c, brush.GetMin(), brush.GetMax(), true);
+                if (brush.mode != BrushMode::Paint) TouchSurfaceHeights(c, brush.GetMin(), brush.GetMax(), false);
+                if (brush.mode != BrushMode::Paint) dirty_chunks.push_back(c.offset);
+            }
+        }
+    }
+}
+
+enum BrushCoverage : uint8_t {
+    BRUSH_OUTSIDE,
+    BRUSH_INSIDE,
+    BRUSH_PARTIAL
+};
+
+// Classifies the voxel centers of a cell against the brush. Every brush shape is convex, so the cell is inside when
+// all 8 corner centers are, and the distance bound lets far cells out after a single evaluation.
+static BrushCoverage ClassifyBrushCell(const VoxelBrush &brush, glm::ivec3 cell_position, uint32_t cell_width) {
+    glm::vec3 low = glm::vec3(cell_position) + 0.5f;
+    float half = float(cell_width - 1) * 0.5f;
+    float half_diagonal = half * 1.7320508f;
+
+    float d = brush.Distance(low + half);
+    if (d > half_diagonal) return BRUSH_OUTSIDE;
+    if (cell_width == 1) return d <= 0.0f ? BRUSH_INSIDE : BRUSH_OUTSIDE;
+    if (d < -half_diagonal) return BRUSH_INSIDE;
+
+    float high = float(cell_width - 1);
+    for (uint8_t corner = 0; corner < 8; corner++) {
+        glm::vec3 offset((corner & 1) ? high : 0.0f, (corner & 2) ? high : 0.0f, (corner & 4) ? high : 0.0f);
+        if (brush.Distance(low + offset) > 0.0f) return BRUSH_PARTIAL;
+    }
+    return BRUSH_INSIDE;
+}
+
+// the voxel a brush leaves behind in a cell that held existing
+static Voxel BrushResult(const VoxelBrush &brush, Voxel existing) {
+    switch (brush.mode) {
+        case BrushMode::Fill:  return brush.voxel;
+        case BrushMode::Carve: return VOXEL_EMPTY;
+        case BrushMode::Paint: {
+            if (!existing.solid()) return existing;
+            Voxel paint = brush.voxel;
+            paint.set_solid(true);
+            return paint;
+        }
+    }
+    return existing;
+}
+
+// the brush on the voxels of a bricked chunk, one distance evaluation per voxel of the brush box
+void VoxelManager::ApplyBrush(Relptr<AllocatedChunksBase> chunk, uint16_t *brick, const VoxelBrush &brush) {
+    glm::ivec3 origin = chunk->position * glm::ivec3(CHUNK_WIDTH);
+    glm::uvec3 low = glm::uvec3(glm::max(brush.GetMin() - origin, glm::ivec3(0)));
+    glm::uvec3 high = glm::uvec3(glm::min(brush.GetMax() - origin, glm::ivec3(CHUNK_WIDTH - 1)));
+    glm::uvec3 p;
+    for (p.z = low.z; p.z <= high.z; p.z++) {
+        for (p.y = low.y; p.y <= high.y; p.y++) {
+            for (p.x = low.x; p.x <= high.x; p.x++) {
+                if (brush.Distance(glm::vec3(origin + glm::ivec3(p)) + 0.5f) > 0.0f) continue;
+                uint16_t &voxel = brick[BrickIndex(p)];
+                voxel = static_cast<uint16_t>(BrushResult(brush, Voxel{voxel}).data);
+            }
+        }
+    }
+    MarkBrickUpload(chunk, low, high);
+}
+
+// repaints every solid voxel below node, then collapses it if that made it uniform
+static void PaintNode(Relptr<ContreeDataBase> node, const VoxelBrush &brush) {
+    for (size_t index = 0; index < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; index++) {
+        if (node->IsVoxel(index)) node->SetVoxel(index, BrushResult(brush, node->GetVoxel(index)));
+        else PaintNode(node->GetPtr(index), brush);
+    }
+    UpdateNodeLod(*node);
+}
+
+void VoxelManager::ApplyBrush(Relptr<ContreeDataBase> node, uint8_t depth, glm::ivec3 node_position, const VoxelBrush &brush) {
+    if (node == nullptr) return;
+    if (depth > CONTREE_MAX_DEPTH) return;
+    upload_nodes.Mark(node.offset);
+
+    uint32_t node_width = CHUNK_WIDTH;
+    for (uint8_t d = 0; d < depth; ++d) node_width /= CONTREE_NODE_WIDTH;
+
+    glm::uvec3 i;
+    for (i.x = 0; i.x < CONTREE_NODE_WIDTH; i.x++) {
+        for (i.y = 0; i.y < CONTREE_NODE_WIDTH; i.y++) {
+            for (i.z = 0; i.z < CONTREE_NODE_WIDTH; i.z++) {
+                uint16_t index = node->GetIndex(i);
+                glm::ivec3 child_pos = node_position + glm::ivec3(i) * (int32_t)node_width;
+
+                BrushCoverage coverage = ClassifyBrushCell(brush, child_pos, node_width);
+                if (coverage == BRUSH_OUTSIDE) continue;
+
+                if (coverage == BRUSH_INSIDE) {
+                    if (node->IsVoxel(index)) {
+                        node->SetVoxel(index, BrushResult(brush, node->GetVoxel(index)));
+                    } else if (brush.mode == BrushMode::Paint) {
+                        // paint keeps the shape of the subtree, only its colors change
+                        Relptr<ContreeDataBase> child = node->GetPtr(index);
+                        PaintNode(child, brush);
+                        MarkSubtreeUpload(child);
+                        if (child->IsUniform()) {
+                            node->SetVoxel(index, child->GetVoxel(0));
+                            FreeContreeNode(child);
+                        }
+                    } else {
+                        FreeContreeNode(node->GetPtr(index));
+                        node->SetVoxel(index, BrushResult(brush, VOXEL_EMPTY));
+                    }
+                    continue;
+                }
+
+                // partial coverage, only possible above the last level since single voxels are always in or out
+                if (node->IsVoxel(index)) {
+                    Voxel existing = node->GetVoxel(index);
+                    if (BrushResult(brush, existing) == existing) continue; // the brush would not change this cell
+                    Relptr<ContreeDataBase> child = AllocateContreeNode();
+                    node->SetPtr(index, child);
+                    FillNodeUniform(child, existing);
+                }
+
+                Relptr<ContreeDataBase> child = node->GetPtr(index);
+                ApplyBrush(child, depth + 1, child_pos, brush);
+                if (child->IsUniform()) { // e.g. a carve that emptied everything the node still held
+                    node->SetVoxel(index, child->GetVoxel(0));
+                    FreeContreeNode(child);
+                }
+            }
+        }
+    }
+    UpdateNodeLod(*node);
 }
 
+void VoxelManager::MarkDirty(glm::ivec3 start_position, glm::ivec3 end_position) {
+    glm::ivec3 low  = glm::min(start_position, end_position);
+    glm::ivec3 high = glm::max(start_position, end_position);
+    glm::ivec3 chunk_start = GetChunkPosition(low);
+    glm::ivec3 chunk_end   = GetChunkPosition(high) + 1;
+
+    for (int32_t cx = chunk_start.x; cx < chunk_end.x; ++cx) {
+        for (int32_t cy = chunk_start.y; cy < chunk_end.y; ++cy) {
+            for (int32_t cz = chunk_start.z; cz < chunk_end.z; ++cz) {
+                Relptr<AllocatedChunksBase> c = GetChunkIndex(glm::ivec3(cx, cy, cz));
+                if (c == nullptr) continue;
+                // direct node writes (prefab stamps) follow, they need the tree
+                UnbrickChunk(c);
+                // anything in the region may have changed, solid or not
+                TouchChunkSummary(c, low, high, true);
+                TouchChunkSummary(c, low, high, false);
+                TouchSurfaceHeights(c, low, high, true);
+                TouchSurfaceHeights(c, low, high, false);
+                dirty_chunks.push_back(c.offset);
+            }
+        }
+    }
+}
+
+// Folds every uniform subtree below node into its parent slot, bottom up so a collapse can enable the next one.
+// Freed node indices go to the caller's list instead of free_contree_indicies so chunks can run in parallel.
+// The lod of every visited node is refreshed on the way up, which also covers nodes written directly (prefab stamps).
+// Nodes that end up different are added to changed. Returns true when node itself is uniform.
+static bool CollapseNode(Relptr<ContreeDataBase> index, std::vector<uint32_t> &freed, std::vector<uint32_t> &changed) {
+    ContreeNode &node = *index;
+    uint64_t voxel_mask = node.isVoxelMask;
+    Voxel lod = node.lod_voxel;
+    float coverage = node.coverage;
+    if (node.isVoxelMask != CONTREE_VOXEL_MASK_FULL) {
+        for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+            if (node.IsVoxel(i)) continue;
+            Relptr<ContreeDataBase> child = node.GetPtr(i);
+            if (!CollapseNode(child, freed, changed)) continue;
+            node.SetVoxel(i, child->GetVoxel(0));
+            freed.push_back(child.offset);
+        }
+    }
+    UpdateNodeLod(node);
+    if (node.isVoxelMask != voxel_mask || node.lod_voxel != lod || node.coverage != coverage) changed.push_back(index.offset);
+    return node.IsUniform();
+}
+
+size_t VoxelManager::Canonicalize(size_t limit) {
+    std::sort(dirty_chunks.begin(), dirty_chunks.end());
+    dirty_chunks.erase(std::unique(dirty_chunks.begin(), dirty_chunks.end()), dirty_chunks.end());
+    std::erase_if(dirty_chunks, [&](uint32_t c) { return c >= allocated_chunks.size(); });
+    std::span<const uint32_t> slice(dirty_chunks.data(), std::min(limit, dirty_chunks.size()));
+
+    // chunks own disjoint subtrees and nothing is allocated here, so they can be walked concurrently
+    std::vector<std::vector<uint32_t>> freed(ParallelWorkerCount(slice.size()));
+    std::vector<std::vector<uint32_t>> changed(freed.size());
+    std::vector<uint8_t> unbrick(slice.size(), 0);
+    std::vector<uint8_t> was_empty(slice.size(), 0);
+    ParallelFor(slice.size(), [&](size_t i, size_t worker) {
+        // the chunk root stays allocated even when uniform, the chunk needs a node to point at
+        Chunk &chunk = allocated_chunks[slice[i]];
+        was_empty[i] = (chunk.flags & CHUNK_FLAG_EMPTY) != 0;
+        if (const uint16_t *brick = GetBrick(chunk)) {
+            UpdateBrickChunk(chunk, brick);
+            changed[worker].push_back(chunk.contree_node.offset);
+            BuildChunkDistances(chunk, brick, chunk_distances.data() + size_t(slice[i]) * CHUNK_DISTANCE_CELLS);
+            unbrick[i] = 1 + BrickSubtreeNodes(brick, glm::uvec3(0), CHUNK_WIDTH, UNBRICK_NODES) <= UNBRICK_NODES;
+        } else {
+            CollapseNode(chunk.contree_node, freed[worker], changed[worker]);
+            UpdateChunkSummary(chunk);
+            BuildChunkDistances(chunk, nullptr, chunk_distances.data() + size_t(slice[i]) * CHUNK_DISTANCE_CELLS);
+        }
+    });
+    // pyramid bits are only ever set incrementally, a chunk that became empty needs the rebuild to clear its bit
+    bool emptied = false;
+    for (size_t i = 0; i < slice.size(); i++) {
+        bool empty = allocated_chunks[slice[i]].flags & CHUNK_FLAG_EMPTY;
+        if (was_empty[i] && !empty) MarkChunkPyramid(allocated_chunks[slice[i]].position); // prefab stamps skip the summary
+        emptied |= !was_empty[i] && empty;
+    }
+    if (emptied) GenerateChunkPyramid();
+
+    size_t reclaimed = 0;
+    for (const std::vector<uint32_t> &list : freed) {
+        free_contree_indicies.insert(free_contree_indicies.end(), list.begin(), list.end());
+        reclaimed += list.size();
+    }
+    for (const std::vector<uint32_t> &list : changed) {
+        for (uint32_t node : list) upload_nodes.Mark(node);
+    }
+    for (uint32_t c : slice) {
+        upload_chunks.Mark(c);
+        upload_distances.Mark(size_t(c) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t), size_t(c + 1) * CHUNK_DISTANCE_CELLS / sizeof(uint32_t));
+    }
+
+    // trees bigger than a brick are detail the tree can't compress, store them dense. a brick only goes back to a tree
+    // well below that size, so edits around the threshold don't convert the chunk back and forth
+    for (size_t i = 0; i < slice.size(); i++) {
+        uint32_t c = slice[i];
+        Chunk &chunk = allocated_chunks[c];
+        if (unbrick[i]) UnbrickChunk(c);
+        if (chunk.flags & CHUNK_FLAG_BRICK) continue;
+        size_t nodes = BrickCandidateNodes(*chunk.contree_node);
+        if (nodes <= BRICK_NODES) continue;
+        BrickChunk(c);
+        reclaimed += nodes - 1;
+    }
+    dirty_chunks.erase(dirty_chunks.begin(), dirty_chunks.begin() + slice.size());
+    if (reclaimed > 0) edit_generation++;
+    return reclaimed;
+}
 
 void VoxelManager::GenerateChunkOccupancyMap() {
+    edit_generation++;
     if (allocated_chunks.empty()) {
         delete[] chunk_occupancy.chunks;
         chunk_occupancy.chunks = nullptr;
+        GenerateChunkPyramid();
+        GenerateSurfaceHeights();
         return;
     }
     // Chunk-space bounds
@@ -339,10 +1477,231 @@ void VoxelManager::GenerateChunkOccupancyMap() {
 
         chunk_occupancy.chunks[index] = i;
     }
+
+    GenerateChunkPyramid();
+    GenerateSurfaceHeights();
+}
+
+void VoxelManager::GenerateChunkPyramid() {
+    upload_directory = true;
+    chunk_pyramid.clear();
+    chunk_pyramid_offsets.clear();
+    chunk_occupancy.pyramid_levels = 0;
+    if (chunk_occupancy.chunks == nullptr) return;
+
+    // level 0 from the directory and the chunk summaries
+    glm::uvec3 size = chunk_occupancy.size;
+    chunk_pyramid_offsets.push_back(0);
+    chunk_pyramid.resize((chunk_occupancy.get_size() + 31) / 32, 0);
+    for (uint32_t i = 0; i < chunk_occupancy.get_size(); i++) {
+        Relptr<AllocatedChunksBase> chunk = chunk_occupancy.chunks[i];
+        if (chunk == nullptr || (chunk->flags & CHUNK_FLAG_EMPTY)) continue;
+        chunk_pyramid[i / 32] |= 1u << (i % 32);
+    }
+    chunk_occupancy.pyramid_levels = 1;
+
+    // every level ORs its 4x4x4 block of the level below, until one cell covers the whole directory
+    while (glm::any(glm::greaterThan(size, glm::uvec3(1)))) {
+        glm::uvec3 below_size = size;
+        uint32_t below = chunk_pyramid_offsets.back();
+        size = ChunkPyramidLevelSize(chunk_occupancy.size, chunk_occupancy.pyramid_levels);
+        uint32_t offset = static_cast<uint32_t>(chunk_pyramid.size());
+        chunk_pyramid_offsets.push_back(offset);
+        chunk_pyramid.resize(offset + (size.x * size.y * size.z + 31) / 32, 0);
+
+        glm::uvec3 cell;
+        for (cell.z = 0; cell.z < below_size.z; cell.z++)
+            for (cell.y = 0; cell.y < below_size.y; cell.y++)
+                for (cell.x = 0; cell.x < below_size.x; cell.x++) {
+                    uint32_t bit = cell.x + cell.y * below_size.x + cell.z * below_size.x * below_size.y;
+                    if (!((chunk_pyramid[below + bit / 32] >> (bit % 32)) & 1)) continue;
+                    glm::uvec3 parent = cell >> CHUNK_PYRAMID_SHIFT;
+                    uint32_t parent_bit = parent.x + parent.y * size.x + parent.z * size.x * size.y;
+                    chunk_pyramid[offset + parent_bit / 32] |= 1u << (parent_bit % 32);
+                }
+        chunk_occupancy.pyramid_levels++;
+    }
+}
+
+int32_t VoxelManager::GetEmptyChunkLevel(glm::ivec3 chunk_position) {
+    glm::ivec3 local = chunk_position - chunk_occupancy.position;
+    if (chunk_pyramid.empty() || glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(glm::uvec3(local), chunk_occupancy.size))) return -1;
+
+    int32_t empty_level = -1;
+    for (uint32_t level = 0; level < chunk_occupancy.pyramid_levels; level++) {
+        glm::uvec3 level_size = ChunkPyramidLevelSize(chunk_occupancy.size, level);
+        glm::uvec3 cell = glm::uvec3(local) >> (CHUNK_PYRAMID_SHIFT * level);
+        uint32_t bit = cell.x + cell.y * level_size.x + cell.z * level_size.x * level_size.y;
+        if ((chunk_pyramid[chunk_pyramid_offsets[level] + bit / 32] >> (bit % 32)) & 1) break;
+        empty_level = static_cast<int32_t>(level);
+    }
+    return empty_level;
+}
+
+// interleaves the bits of the chunk position so chunks close in space end up close in memory
+static uint64_t ChunkMortonCode(glm::ivec3 position) {
+    uint64_t code = 0;
+    glm::uvec3 p = glm::uvec3(position + glm::ivec3(1 << 20)); // chunk positions are signed, 21 bits each covers them
+    for (uint32_t bit = 0; bit < 21; bit++) {
+        code |= uint64_t((p.x >> bit) & 1) << (bit * 3);
+        code |= uint64_t((p.y >> bit) & 1) << (bit * 3 + 1);
+        code |= uint64_t((p.z >> bit) & 1) << (bit * 3 + 2);
+    }
+    return code;
+}
+
+void VoxelManager::CompactNodes() {
+    if (!dirty_chunks.empty()) Canonicalize();
+    edit_generation++;
+    chunk_generation++;
+
+    std::sort(allocated_chunks.begin(), allocated_chunks.end(), [](const Chunk &a, const Chunk &b) {
+        return ChunkMortonCode(a.position) < ChunkMortonCode(b.position);
+    });
+    std::vector<Relptr<ContreeDataBase>> detached;
+    for (const std::vector<Relptr<ContreeDataBase>> *roots : detached_roots) detached.insert(detached.end(), roots->begin(), roots->end());
+    ReorderNodes(contree_data, allocated_chunks, detached);
+    size_t next = 0;
+    for (std::vector<Relptr<ContreeDataBase>> *roots : detached_roots) {
+        for (Relptr<ContreeDataBase> &root : *roots) root = detached[next++];
+    }
+    free_contree_indicies.clear();
+
+    // bricks follow the chunk order as well, free slots are dropped
+    std::vector<uint16_t> bricks;
+    for (Chunk &chunk : allocated_chunks) {
+        if (!(chunk.flags & CHUNK_FLAG_BRICK)) continue;
+        const uint16_t *brick = GetBrick(chunk);
+        chunk.brick = static_cast<uint32_t>(bricks.size() / CHUNK_BRICK_VOXELS);
+        bricks.insert(bricks.end(), brick, brick + CHUNK_BRICK_VOXELS);
+    }
+    brick_data.swap(bricks);
+    free_bricks.clear();
+    GenerateChunkDistances();
+
+    if (!allocated_chunks.empty()) GenerateChunkOccupancyMap();
+    MarkWorldUpload();
+}
+
+void VoxelManager::RegisterDetachedRoots(std::vector<Relptr<ContreeDataBase>> *roots) {
+    detached_roots.push_back(roots);
+}
+
+void VoxelManager::UnregisterDetachedRoots(std::vector<Relptr<ContreeDataBase>> *roots) {
+    std::erase(detached_roots, roots);
+}
+
+bool VoxelManager::SaveWorld(const std::string &path) {
+    ChunkPositionsHeader directory{chunk_occupancy.position, chunk_occupancy.size};
+    std::span<const uint32_t> directory_chunks(reinterpret_cast<const uint32_t*>(chunk_occupancy.chunks), chunk_occupancy.chunks ? chunk_occupancy.get_size() : 0);
+    return WriteWorldFile(path, 0, contree_data, allocated_chunks, materials, directory, directory_chunks, brick_data);
+}
+
+// Copies every node reached a second time, so each node has one parent again and edits stay local to their chunk.
+static void UnshareNode(std::vector<ContreeNode> &nodes, std::vector<bool> &visited, uint32_t index) {
+    if (nodes[index].isVoxelMask == CONTREE_VOXEL_MASK_FULL) return;
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        if (nodes[index].IsVoxel(i)) continue;
+        uint32_t child = nodes[index].child_nodes[i].offset;
+        if (visited[child]) {
+            nodes.push_back(nodes[child]);
+            visited.push_back(true);
+            child = static_cast<uint32_t>(nodes.size() - 1);
+            nodes[index].child_nodes[i] = child;
+        }
+        visited[child] = true;
+        UnshareNode(nodes, visited, child);
+    }
+}
+
+// True when every child and material below index is in range and the tree is at most CONTREE_MAX_DEPTH levels deep, which
+// also rules out cycles. depths keeps the shallowest depth a node passed at, a shared node that fits there fits deeper.
+static bool ValidNode(std::span<const ContreeNode> nodes, size_t material_count, std::vector<uint8_t> &depths, uint32_t index, uint8_t depth) {
+    if (index >= nodes.size()) return false;
+    if (depths[index] <= depth) return true;
+    const ContreeNode &node = nodes[index];
+    if (node.lod_voxel.material() >= material_count) return false;
+    for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+        if ((node.isVoxelMask >> i) & 1ULL) {
+            if (node.voxel_data[i].material() >= material_count) return false;
+            continue;
+        }
+        if (depth + 1 >= CONTREE_MAX_DEPTH) return false;
+        if (!ValidNode(nodes, material_count, depths, node.child_nodes[i].offset, depth + 1)) return false;
+    }
+    depths[index] = depth; // only once the children passed, so a cycle runs into the depth limit instead
+    return true;
+}
+
+bool VoxelManager::LoadWorld(const std::string &path) {
+    // everything is read and checked on the side, a bad file leaves the current world untouched
+    WorldFileHeader header;
+    std::vector<ContreeNode> nodes;
+    std::vector<Chunk> chunks;
+    std::vector<Material> file_materials;
+    std::vector<uint32_t> directory;
+    std::vector<uint16_t> bricks;
+    if (!ReadWorldFile(path, header, nodes, chunks, file_materials, directory, bricks)) return false;
+    if (file_materials.size() <= MATERIAL_DEFAULT) return false;
+
+    std::vector<uint8_t> depths(nodes.size(), UINT8_MAX);
+    // slots no chunk points at were free when the world was saved
+    std::vector<bool> used_bricks(bricks.size() / CHUNK_BRICK_VOXELS, false);
+    for (const Chunk &chunk : chunks) {
+        if (!ValidNode(nodes, file_materials.size(), depths, chunk.contree_node.offset, 0)) return false;
+        if (!(chunk.flags & CHUNK_FLAG_BRICK)) continue;
+        if (chunk.brick >= used_bricks.size() || used_bricks[chunk.brick]) return false;
+        used_bricks[chunk.brick] = true;
+    }
+    for (uint32_t chunk : directory) {
+        if (chunk != POINTER_EMPTY && chunk >= chunks.size()) return false;
+    }
+
+    contree_data.swap(nodes);
+    for (std::vector<Relptr<ContreeDataBase>> *roots : detached_roots) roots->clear();
+    allocated_chunks.swap(chunks);
+    materials.swap(file_materials);
+    brick_data.swap(bricks);
+    edit_generation++;
+    chunk_generation++;
+    free_contree_indicies.clear();
+    dirty_chunks.clear();
+
+    free_bricks.clear();
+    for (uint32_t slot = 0; slot < used_bricks.size(); slot++) {
+        if (!used_bricks[slot]) free_bricks.push_back(slot);
+    }
+
+    if (header.flags & WORLD_FLAG_SHARED_NODES) {
+        std::vector<bool> visited(contree_data.size(), false);
+        for (Chunk &chunk : allocated_chunks) {
+            uint32_t root = chunk.contree_node.offset;
+            if (visited[root]) {
+                contree_data.push_back(contree_data[root]);
+                visited.push_back(true);
+                root = static_cast<uint32_t>(contree_data.size() - 1);
+                chunk.contree_node = root;
+            }
+            visited[root] = true;
+            UnshareNode(contree_data, visited, root);
+        }
+    }
+
+    delete[] chunk_occupancy.chunks;
+    chunk_occupancy.position = header.directory.position;
+    chunk_occupancy.size = header.directory.size;
+    chunk_occupancy.chunks = new Relptr<AllocatedChunksBase>[directory.size()];
+    for (size_t i = 0; i < directory.size(); i++) chunk_occupancy.chunks[i] = directory[i];
+    // both are cheap next to the node data, so they are not stored in the file
+    GenerateChunkPyramid();
+    GenerateChunkDistances();
+    GenerateSurfaceHeights();
+    MarkWorldUpload();
+    return true;
 }
 
 size_t VoxelManager::GetChunkDataAllocatedBytes() const {
-    return contree_data.capacity() * sizeof(ContreeNode);
+    return contree_data.capacity() * sizeof(ContreeNode) + brick_data.capacity() * sizeof(uint16_t);
 }
 
 static void DumpNode(
@@ -3,11 +3,17 @@
 #include "engine.h"
 
 #include <vector>
+#include <deque>
 #include <functional>
+#include <span>
 
 #include "glm/vec3.hpp"
 
 #include "voxel.h"
+#include "voxelbrush.h"
+#include "voxeledit.h"
+
+#include "dirtyranges/dirtyranges.hpp"
 
 
 class VoxelManager : public EngineModule {
@@ -18,6 +24,7 @@ class VoxelManager : public EngineModule {
         void Shutdown(void) override;
 
         Relptr<ContreeDataBase> AllocateContreeNode(void);
+        uint32_t AllocateContreeRun(size_t count); // count consecutive nodes, reusing freed ones when possible
         void FreeContreeNode(Relptr<ContreeDataBase> root);
         //void FreeContreeNode(Relptr<ContreeDataBase> root);
         Relptr<AllocatedChunksBase> AllocateChunk(glm::ivec3 position);
@@ -33,24 +40,129 @@ class VoxelManager : public EngineModule {
         // chunk space getting and setting voxels
         void SetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 position, Voxel voxel);
         Voxel GetVoxel(Relptr<AllocatedChunksBase> chunk, glm::uvec3 position);
+        // batched lookup of many unrelated positions, voxels[i] receives the voxel at positions[i]
+        void GetVoxels(std::span<const glm::ivec3> positions, std::span<Voxel> voxels);
 
         void FillNodeUniform(Relptr<ContreeDataBase> node, Voxel voxel);
 
+        // swaps a chunk's tree for one built outside contree_data (importers), child pointers of root and nodes index into nodes
+        void ReplaceChunkContree(Relptr<AllocatedChunksBase> chunk, const ContreeNode &root, std::span<const ContreeNode> nodes);
+
         void FillVoxels(glm::ivec3 start_position, glm::ivec3 end_position, Voxel voxel);
         void FillVoxels(Relptr<ContreeDataBase> node, uint8_t depth, glm::ivec3 node_position, glm::ivec3 start_position, glm::ivec3 end_position, Voxel voxel);
 
+        // analytic shapes, only nodes on the brush surface are subdivided
+        void ApplyBrush(const VoxelBrush &brush);
+        void ApplyBrush(Relptr<ContreeDataBase> node, uint8_t depth, glm::ivec3 node_position, const VoxelBrush &brush);
+        void ApplyBrush(Relptr<AllocatedChunksBase> chunk, uint16_t *brick, const VoxelBrush &brush);
+
+        // Edits the renderer applies on the GPU (voxeledit.slang) from the next frame on, without waiting for the
+        // contrees. Process replays them into the contrees a few milliseconds worth per frame, oldest first, and they
+        // stay in pending_edits until then.
+        void QueueEdit(VoxelEdit edit);
+        void ApplyEdit(const VoxelEdit &edit);
+        void MarkChunkUpload(uint32_t chunk); // the chunk's record, distance field and every node of its tree
+
         void FillSDF(Voxel voxel, std::function<float(glm::vec3 pos)>);
         void FillSDF(Relptr<ContreeDataBase> node, Voxel voxel, std::function<float(glm::vec3 pos)>);
 
+        // Bulk edits leave uniform subtrees behind. They record the chunks they touched and Canonicalize folds
+        // those subtrees back into their parent slot, returning the number of nodes reclaimed. It also tightens the
+        // chunk summaries (Chunk::flags and solid bounds), which edits only keep conservative. At most limit dirty
+        // chunks are handled per call, the rest stay queued; Process works through them a time budgeted slice at a time.
+        void MarkDirty(glm::ivec3 start_position, glm::ivec3 end_position);
+        size_t Canonicalize(size_t limit = SIZE_MAX);
+
+        // Canonicalize moves a chunk into a dense brick (CHUNK_FLAG_BRICK) when its tree would take more memory than
+        // the brick, and back into a tree once the tree would take less than half. Edits write into the brick directly,
+        // only voxels with a material the brick can't hold turn the chunk back into a tree right away.
+        void BrickChunk(Relptr<AllocatedChunksBase> chunk);
+        void UnbrickChunk(Relptr<AllocatedChunksBase> chunk);
+
         void GenerateChunkOccupancyMap(void);
+
+        // Occupancy pyramid over the chunk directory. Level 0 has a bit per directory cell, set when the chunk may hold
+        // solid voxels, every level above ORs 4x4x4 cells of the one below, up to a level of a single cell. Levels are
+        // stored one after the other, each starting on a new word, and uploaded right behind the directory.
+        void GenerateChunkPyramid(void);
+        // -1 when the chunk may hold solid voxels, otherwise the highest level whose cell around it is empty
+        int32_t GetEmptyChunkLevel(glm::ivec3 chunk_position);
+
+        // Rebuilds the distance field (CHUNK_DISTANCE_CELLS) of every chunk. Edits keep the fields conservative by
+        // lowering the cells around new solid voxels, Canonicalize rebuilds the fields of dirty chunks.
+        void GenerateChunkDistances(void);
+        // the distance field cell of chunk holding the chunk local position
+        uint8_t GetChunkDistance(Relptr<AllocatedChunksBase> chunk, glm::uvec3 position) const;
+
+        // Height of the highest solid voxel of every world column (x, z) over the chunk directory, rebuilt with the
+        // directory. Edits raise the columns they fill and mark the ones they may have lowered, a marked column is
+        // rescanned by the next query or Process. SURFACE_HEIGHT_NONE for air columns and columns outside the directory.
+        void GenerateSurfaceHeights(void);
+        int32_t GetSurfaceHeight(int32_t x, int32_t z);
+        void UpdateSurfaceHeights(void); // rescans every marked column, surface_heights is exact afterwards. Process calls it
+
+        // Reorders chunks along a z order curve and their nodes depth first (see ReorderNodes) and drops freed nodes.
+        // Pending dirty chunks are canonicalized first. Every Relptr into contree_data held outside the world is invalidated,
+        // except the registered detached roots, which are kept and remapped.
+        void CompactNodes(void);
+
+        // Trees in contree_data that no chunk points at (VoxelPrefab). CompactNodes keeps and remaps the roots in place,
+        // LoadWorld empties the vector since its nodes went away with the old world.
+        void RegisterDetachedRoots(std::vector<Relptr<ContreeDataBase>> *roots);
+        void UnregisterDetachedRoots(std::vector<Relptr<ContreeDataBase>> *roots);
+
+        // compiled world files (worldfile.h), loading replaces everything the manager holds. A file that fails to read or
+        // points outside its own sections is rejected and leaves the current world as it was
+        bool SaveWorld(const std::string &path);
+        bool LoadWorld(const std::string &path);
         
         size_t GetChunkDataAllocatedBytes(void) const; // returns allocated data byte count
 
         std::string DumpContreeGraph(uint32_t rootIndex);
 
+        // registers a material (or finds an identical one) and returns the index voxels store
+        uint16_t AddMaterial(const Material &material);
+
+        uint32_t edit_generation = 0; // bumped by every edit so cached paths (VoxelCursor) know to re-descend
+        uint32_t chunk_generation = 0; // bumped when chunks change their allocated_chunks index, for data keyed by it
+
         std::vector<ContreeNode> contree_data{};
         std::vector<Chunk> allocated_chunks{};
         ChunkPositions chunk_occupancy{};
+        std::vector<uint32_t> chunk_pyramid{};
+        std::vector<uint32_t> chunk_pyramid_offsets{}; // first word of every level
+        std::vector<uint8_t> chunk_distances{}; // CHUNK_DISTANCE_CELLS per chunk, in allocated_chunks order
+        std::vector<uint16_t> brick_data{}; // CHUNK_BRICK_VOXELS per brick slot
+        std::vector<int32_t> surface_heights{}; // one per column of the directory footprint, x fastest
+        std::vector<Material> materials{}; // materials[MATERIAL_DEFAULT] leaves the voxel color untouched
+
+        // What changed since the renderer last copied the world to the GPU: contree_data nodes, allocated_chunks
+        // records, words of chunk_distances and words (two voxels) of brick_data. upload_directory covers the chunk_occupancy header,
+        // the directory and the pyramid. Code writing nodes directly (prefab stamps) marks them itself.
+        DirtyRanges upload_nodes{};
+        DirtyRanges upload_chunks{};
+        DirtyRanges upload_distances{};
+        DirtyRanges upload_bricks{};
+        bool upload_directory = true;
+
+        std::deque<VoxelEdit> pending_edits{}; // queued but not replayed yet, what the GPU applies every frame
     private:
         std::vector<uint32_t> free_contree_indicies{};  
+        std::vector<uint32_t> dirty_chunks{}; // offsets into allocated_chunks, may hold duplicates until Canonicalize
+        std::vector<uint32_t> free_bricks{};
+        std::vector<uint32_t> stale_surface_columns{}; // surface_heights indices, may hold duplicates until UpdateSurfaceHeights
+        std::vector<std::vector<Relptr<ContreeDataBase>>*> detached_roots{};
+
+        void TouchChunkSummary(Relptr<AllocatedChunksBase> chunk, glm::ivec3 start_position, glm::ivec3 end_position, bool solid);
+        void MarkChunkPyramid(glm::ivec3 chunk_position);
+        void LowerChunkDistances(Relptr<AllocatedChunksBase> chunk, glm::uvec3 low, glm::uvec3 high);
+        void UnbrickNode(Relptr<ContreeDataBase> node, size_t index, const uint16_t *brick, glm::uvec3 position, uint32_t width);
+        void FreeBrick(Relptr<AllocatedChunksBase> chunk);
+        uint16_t *EditBrick(Relptr<AllocatedChunksBase> chunk, Voxel voxel);
+        void MarkBrickUpload(Relptr<AllocatedChunksBase> chunk, glm::uvec3 low, glm::uvec3 high);
+        void MarkSubtreeUpload(Relptr<ContreeDataBase> node);
+        void MarkWorldUpload(void);
+        void TouchSurfaceHeights(Relptr<AllocatedChunksBase> chunk, glm::ivec3 start_position, glm::ivec3 end_position, bool solid);
+        int32_t ScanSurfaceHeight(int32_t x, int32_t z);
+        const uint16_t *GetBrick(const Chunk &chunk) const; // nullptr unless the chunk is bricked
 };
\ No newline at end of file
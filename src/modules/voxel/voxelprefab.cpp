@@ -0,0 +1,314 @@
+#include "voxelprefab.h"
+#include "voxelcursor.h"
+
+#include "glm/common.hpp"
+
+static constexpr uint32_t NODE_CHILD_COUNT = CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+
+static glm::ivec3 ChildPosition(uint32_t index) {
+    return glm::ivec3(
+        index % CONTREE_NODE_WIDTH,
+        (index / CONTREE_NODE_WIDTH) % CONTREE_NODE_WIDTH,
+        index / (CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH)
+    );
+}
+
+VoxelTransform VoxelTransform::FromIndex(uint8_t index) {
+    static constexpr uint8_t permutations[6][3] = {
+        {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}
+    };
+    VoxelTransform transform;
+    const uint8_t *permutation = permutations[(index / 8) % 6];
+    for (uint8_t i = 0; i < 3; i++) {
+        transform.axes[i] = permutation[i];
+        transform.flip[i] = (index >> i) & 1;
+    }
+    return transform;
+}
+
+VoxelTransform VoxelTransform::RotateY(uint8_t quarter_turns) {
+    VoxelTransform transform;
+    switch (quarter_turns % 4) {
+        case 1: transform.axes[0] = 2; transform.axes[2] = 0; transform.flip[2] = true; break;
+        case 2: transform.flip[0] = true; transform.flip[2] = true; break;
+        case 3: transform.axes[0] = 2; transform.axes[2] = 0; transform.flip[0] = true; break;
+        default: break;
+    }
+    return transform;
+}
+
+bool VoxelTransform::IsMirror() const {
+    // an odd permutation or an odd number of flips (but not both) turns the handedness around
+    bool odd_permutation = (axes[0] > axes[1]) ^ (axes[0] > axes[2]) ^ (axes[1] > axes[2]);
+    bool odd_flips = flip[0] ^ flip[1] ^ flip[2];
+    return odd_permutation != odd_flips;
+}
+
+glm::ivec3 VoxelTransform::Extent(glm::ivec3 extent) const {
+    return glm::ivec3(extent[axes[0]], extent[axes[1]], extent[axes[2]]);
+}
+
+glm::ivec3 VoxelTransform::Apply(glm::ivec3 position, glm::ivec3 extent) const {
+    glm::ivec3 result;
+    for (uint8_t i = 0; i < 3; i++) {
+        int32_t value = position[axes[i]];
+        result[i] = flip[i] ? extent[axes[i]] - 1 - value : value;
+    }
+    return result;
+}
+
+VoxelPrefab::VoxelPrefab(VoxelManager &manager, glm::ivec3 size) : manager(manager), size(size) {
+    root_count = (size + glm::ivec3(CHUNK_WIDTH - 1)) / glm::ivec3(CHUNK_WIDTH);
+    roots.resize(root_count.x * root_count.y * root_count.z);
+    for (Relptr<ContreeDataBase> &root : roots) {
+        root = manager.AllocateContreeNode();
+    }
+    manager.RegisterDetachedRoots(&roots);
+}
+
+VoxelPrefab::~VoxelPrefab() {
+    manager.UnregisterDetachedRoots(&roots);
+    for (Relptr<ContreeDataBase> root : roots) {
+        manager.FreeContreeNode(root);
+    }
+}
+
+void VoxelPrefab::Fill(glm::ivec3 start_position, glm::ivec3 end_position, Voxel voxel) {
+    glm::ivec3 fill_start = glm::max(glm::min(start_position, end_position), glm::ivec3(0));
+    glm::ivec3 fill_end   = glm::min(glm::max(start_position, end_position), size - glm::ivec3(1));
+    if (glm::any(glm::greaterThan(fill_start, fill_end)) || roots.empty()) return;
+
+    glm::ivec3 r;
+    for (r.z = 0; r.z < root_count.z; r.z++)
+        for (r.y = 0; r.y < root_count.y; r.y++)
+            for (r.x = 0; r.x < root_count.x; r.x++) {
+                Relptr<ContreeDataBase> root = roots[r.x + r.y * root_count.x + r.z * root_count.x * root_count.y];
+                manager.FillVoxels(root, 1, r * glm::ivec3(CHUNK_WIDTH), fill_start, fill_end, voxel);
+            }
+}
+
+void VoxelPrefab::Capture(glm::ivec3 world_position) {
+    if (roots.empty()) return;
+    VoxelCursor cursor(manager, world_position);
+    for (int32_t z = 0; z < size.z; z++) {
+        for (int32_t y = 0; y < size.y; y++) {
+            cursor.Seek(world_position + glm::ivec3(0, y, z));
+
+            // copy runs of equal voxels along x as one fill each
+            int32_t run_start = 0;
+            Voxel run_voxel = cursor.Get();
+            for (int32_t x = 1; x <= size.x; x++) {
+                Voxel voxel = VOXEL_EMPTY;
+                if (x < size.x) {
+                    cursor.MoveX(1);
+                    voxel = cursor.Get();
+                    if (voxel == run_voxel) continue;
+                }
+                if (run_voxel.solid()) Fill(glm::ivec3(run_start, y, z), glm::ivec3(x - 1, y, z), run_voxel);
+                run_start = x;
+                run_voxel = voxel;
+            }
+        }
+    }
+}
+
+void VoxelPrefab::Stamp(glm::ivec3 position, VoxelTransform transform) {
+    if (roots.empty()) return; // the world was replaced since the prefab was built
+    manager.edit_generation++;
+    manager.MarkDirty(position, position + transform.Extent(size) - 1);
+
+    glm::ivec3 storage = root_count * glm::ivec3(CHUNK_WIDTH);
+
+    // the transform maps the whole 64 aligned storage, shift it so the transformed content box starts at position
+    glm::ivec3 origin = position;
+    for (uint8_t i = 0; i < 3; i++) {
+        if (transform.flip[i]) origin[i] -= storage[transform.axes[i]] - size[transform.axes[i]];
+    }
+
+    uint32_t cell_width = 1;
+    if (glm::all(glm::equal(origin & glm::ivec3(15), glm::ivec3(0)))) cell_width = 16;
+    else if (glm::all(glm::equal(origin & glm::ivec3(3), glm::ivec3(0)))) cell_width = 4;
+
+    uint8_t permutation[NODE_CHILD_COUNT];
+    for (uint32_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        glm::ivec3 p = transform.Apply(ChildPosition(i), glm::ivec3(CONTREE_NODE_WIDTH));
+        permutation[i] = static_cast<uint8_t>(p.x + p.y * CONTREE_NODE_WIDTH + p.z * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH);
+    }
+
+    glm::ivec3 r;
+    for (r.z = 0; r.z < root_count.z; r.z++)
+        for (r.y = 0; r.y < root_count.y; r.y++)
+            for (r.x = 0; r.x < root_count.x; r.x++) {
+                Relptr<ContreeDataBase> root = roots[r.x + r.y * root_count.x + r.z * root_count.x * root_count.y];
+                glm::ivec3 root_position = r * glm::ivec3(CHUNK_WIDTH);
+
+                if (cell_width == 1) {
+                    StampUnaligned(root, 1, root_position, origin, transform);
+                    continue;
+                }
+
+                // walk down to the cells of cell_width, every one of them maps onto exactly one world cell
+                struct Cell {
+                    Relptr<ContreeDataBase> node;
+                    glm::ivec3 position;
+                    uint32_t width;
+                };
+                FixedStack<Cell, NODE_CHILD_COUNT * 2> stack;
+                stack.push({root, root_position, CHUNK_WIDTH / CONTREE_NODE_WIDTH});
+                while (!stack.empty()) {
+                    Cell cell = stack.pop();
+                    for (uint32_t i = 0; i < NODE_CHILD_COUNT; i++) {
+                        glm::ivec3 child_position = cell.position + ChildPosition(i) * (int32_t)cell.width;
+                        bool is_voxel = cell.node->IsVoxel(i);
+                        if (!is_voxel && cell.width > cell_width) {
+                            stack.push({cell.node->GetPtr(i), child_position, cell.width / CONTREE_NODE_WIDTH});
+                            continue;
+                        }
+
+                        glm::ivec3 a = transform.Apply(child_position, storage);
+                        glm::ivec3 b = transform.Apply(child_position + glm::ivec3(cell.width - 1), storage);
+                        glm::ivec3 world_min = origin + glm::min(a, b);
+                        if (!is_voxel) {
+                            StampCell(cell.node->GetPtr(i), world_min, cell.width, permutation);
+                            continue;
+                        }
+
+                        Voxel voxel = cell.node->GetVoxel(i);
+                        if (!voxel.solid()) continue;
+                        if (cell.width > cell_width) { // uniform cell bigger than the stamp grid, it may straddle world cells
+                            manager.FillVoxels(world_min, origin + glm::max(a, b), voxel);
+                            continue;
+                        }
+
+                        Relptr<ContreeDataBase> node;
+                        size_t index;
+                        if (!FindWorldSlot(world_min, cell.width, node, index)) continue;
+                        if (!node->IsVoxel(index)) manager.FreeContreeNode(node->GetPtr(index));
+                        node->SetVoxel(index, voxel);
+                        manager.upload_nodes.Mark(node.offset);
+                    }
+                }
+            }
+}
+
+// Finds the world node slot covering one aligned cell of cell_width, splitting uniform cells on the way down.
+bool VoxelPrefab::FindWorldSlot(glm::ivec3 world_cell, uint32_t cell_width, Relptr<ContreeDataBase> &node, size_t &index) {
+    glm::ivec3 chunk_position = manager.GetChunkPosition(world_cell);
+    Relptr<AllocatedChunksBase> chunk = manager.GetChunkIndex(chunk_position);
+    if (chunk == nullptr) return false;
+
+    glm::uvec3 local = world_cell - chunk_position * glm::ivec3(CHUNK_WIDTH);
+    node = chunk->contree_node;
+    uint32_t child_width = CHUNK_WIDTH / CONTREE_NODE_WIDTH;
+    index = node->GetIndex(local / child_width);
+
+    while (child_width > cell_width) {
+        if (node->IsVoxel(index)) {
+            Voxel existing = node->GetVoxel(index);
+            Relptr<ContreeDataBase> split = manager.AllocateContreeNode();
+            manager.FillNodeUniform(split, existing);
+            node->SetPtr(index, split);
+            manager.upload_nodes.Mark(node.offset);
+        }
+        node = node->GetPtr(index);
+        local %= child_width;
+        child_width /= CONTREE_NODE_WIDTH;
+        index = node->GetIndex(local / child_width);
+    }
+    return true;
+}
+
+// Places a source subtree covering one aligned world cell: a deep copy when the world cell is air, a merge otherwise.
+void VoxelPrefab::StampCell(Relptr<ContreeDataBase> source, glm::ivec3 world_cell, uint32_t cell_width, const uint8_t *permutation) {
+    Relptr<ContreeDataBase> node;
+    size_t index;
+    if (!FindWorldSlot(world_cell, cell_width, node, index)) return;
+
+    if (!node->IsVoxel(index)) {
+        MergeNode(node->GetPtr(index), source, permutation);
+        return;
+    }
+
+    Voxel existing = node->GetVoxel(index);
+    manager.upload_nodes.Mark(node.offset);
+    if (!existing.solid()) {
+        Relptr<ContreeDataBase> copy = CopyNode(source, permutation);
+        node->SetPtr(index, copy);
+        return;
+    }
+
+    Relptr<ContreeDataBase> split = manager.AllocateContreeNode();
+    manager.FillNodeUniform(split, existing);
+    node->SetPtr(index, split);
+    MergeNode(split, source, permutation);
+}
+
+void VoxelPrefab::StampUnaligned(Relptr<ContreeDataBase> node, uint8_t depth, glm::ivec3 local_position, glm::ivec3 origin, const VoxelTransform &transform) {
+    glm::ivec3 storage = root_count * glm::ivec3(CHUNK_WIDTH);
+    int32_t child_width = CHUNK_WIDTH;
+    for (uint8_t d = 0; d < depth; d++) child_width /= CONTREE_NODE_WIDTH;
+
+    for (uint32_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        glm::ivec3 child_position = local_position + ChildPosition(i) * child_width;
+        if (!node->IsVoxel(i)) {
+            StampUnaligned(node->GetPtr(i), depth + 1, child_position, origin, transform);
+            continue;
+        }
+
+        Voxel voxel = node->GetVoxel(i);
+        if (!voxel.solid()) continue;
+
+        glm::ivec3 a = transform.Apply(child_position, storage);
+        if (child_width == 1) {
+            manager.SetVoxel(origin + a, voxel);
+            continue;
+        }
+        glm::ivec3 b = transform.Apply(child_position + glm::ivec3(child_width - 1), storage);
+        manager.FillVoxels(origin + glm::min(a, b), origin + glm::max(a, b), voxel);
+    }
+}
+
+Relptr<ContreeDataBase> VoxelPrefab::CopyNode(Relptr<ContreeDataBase> source, const uint8_t *permutation) {
+    Relptr<ContreeDataBase> copy = manager.AllocateContreeNode();
+    for (uint32_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        if (source->IsVoxel(i)) {
+            copy->SetVoxel(permutation[i], source->GetVoxel(i));
+            continue;
+        }
+        Relptr<ContreeDataBase> child = CopyNode(source->GetPtr(i), permutation); // may grow contree_data, resolve copy afterwards
+        copy->SetPtr(permutation[i], child);
+    }
+    return copy;
+}
+
+void VoxelPrefab::MergeNode(Relptr<ContreeDataBase> destination, Relptr<ContreeDataBase> source, const uint8_t *permutation) {
+    manager.upload_nodes.Mark(destination.offset);
+    for (uint32_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        uint8_t target = permutation[i];
+
+        if (source->IsVoxel(i)) {
+            Voxel voxel = source->GetVoxel(i);
+            if (!voxel.solid()) continue; // air in a prefab never carves
+            if (!destination->IsVoxel(target)) manager.FreeContreeNode(destination->GetPtr(target));
+            destination->SetVoxel(target, voxel);
+            continue;
+        }
+
+        if (!destination->IsVoxel(target)) {
+            MergeNode(destination->GetPtr(target), source->GetPtr(i), permutation);
+            continue;
+        }
+
+        Voxel existing = destination->GetVoxel(target);
+        if (!existing.solid()) {
+            Relptr<ContreeDataBase> copy = CopyNode(source->GetPtr(i), permutation);
+            destination->SetPtr(target, copy);
+            continue;
+        }
+
+        Relptr<ContreeDataBase> split = manager.AllocateContreeNode();
+        manager.FillNodeUniform(split, existing);
+        destination->SetPtr(target, split);
+        MergeNode(split, source->GetPtr(i), permutation);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "voxelmanager.h"
+
+// One of the 48 axis aligned orientations: output axis i reads input axis axes[i], mirrored when flip[i] is set.
+// Indices 0-47 enumerate every permutation (index / 8) and flip combination (index % 8), IsMirror() tells the
+// 24 mirrored ones apart from the 24 proper rotations.
+struct VoxelTransform {
+    uint8_t axes[3] = {0, 1, 2};
+    bool flip[3] = {false, false, false};
+
+    static VoxelTransform FromIndex(uint8_t index);
+    static VoxelTransform RotateY(uint8_t quarter_turns);
+
+    bool IsMirror(void) const;
+
+    glm::ivec3 Extent(glm::ivec3 extent) const; // size of a box of the given extent after the transform
+    glm::ivec3 Apply(glm::ivec3 position, glm::ivec3 extent) const; // maps a position inside [0, extent) into [0, Extent(extent))
+};
+
+// A small contree captured once and stamped into the world many times. The prefab owns detached root nodes in the
+// VoxelManager's contree_data (one per 64^3 block of its size), so the stamp can copy whole subtrees at node level.
+// The roots are registered with the manager: CompactNodes remaps them, LoadWorld drops them and leaves the prefab empty.
+class VoxelPrefab {
+    public:
+        VoxelPrefab(VoxelManager &manager, glm::ivec3 size);
+        ~VoxelPrefab();
+
+        VoxelPrefab(const VoxelPrefab&) = delete;
+        VoxelPrefab& operator=(const VoxelPrefab&) = delete;
+
+        // prefab local editing, positions are inclusive and clipped to the prefab size
+        void Fill(glm::ivec3 start_position, glm::ivec3 end_position, Voxel voxel);
+        void Capture(glm::ivec3 world_position); // copies the world region [world_position, world_position + size)
+
+        // Merges the solid voxels of the prefab into the world with the transformed prefab's min corner at position.
+        // When the stamp lands on a 16 or 4 voxel grid whole subtrees are copied into empty space, otherwise it falls back
+        // to box fills for uniform cells and per voxel merges for leaves.
+        void Stamp(glm::ivec3 position, VoxelTransform transform = {});
+
+        glm::ivec3 GetSize(void) const { return size; }
+    private:
+        bool FindWorldSlot(glm::ivec3 world_cell, uint32_t cell_width, Relptr<ContreeDataBase> &node, size_t &index);
+        void StampCell(Relptr<ContreeDataBase> source, glm::ivec3 world_cell, uint32_t cell_width, const uint8_t *permutation);
+        void StampUnaligned(Relptr<ContreeDataBase> node, uint8_t depth, glm::ivec3 local_position, glm::ivec3 origin, const VoxelTransform &transform);
+        Relptr<ContreeDataBase> CopyNode(Relptr<ContreeDataBase> source, const uint8_t *permutation);
+        void MergeNode(Relptr<ContreeDataBase> destination, Relptr<ContreeDataBase> source, const uint8_t *permutation);
+
+        VoxelManager &manager;
+        glm::ivec3 size{};
+        glm::ivec3 root_count{};
+        std::vector<Relptr<ContreeDataBase>> roots{};
+};
\ No newline at end of file
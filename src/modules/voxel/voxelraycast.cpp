@@ -0,0 +1,216 @@
+#include "voxelraycast.h"
+
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+
+#include <limits>
+
+static constexpr uint32_t MAX_RAYCAST_STEPS = 4096;
+
+static int32_t FloorDiv(int32_t value, int32_t width) {
+    return value >= 0 ? value / width : (value - width + 1) / width;
+}
+
+// the cell a point on the ray belongs to, a point exactly on a boundary goes to the cell the ray is heading into
+static int32_t RayCell(float position, float direction) {
+    float cell = glm::floor(position);
+    if (direction < 0.0f && cell == position) cell -= 1.0f;
+    return int32_t(cell);
+}
+
+// the 4 occupancy bits of the row through child along axis, bit k is the child with child[axis] == k
+static uint32_t OccupancyRow(uint64_t occupancy, glm::uvec3 child, uint8_t axis) {
+    static constexpr uint32_t STRIDE[3] = {1, CONTREE_NODE_WIDTH, CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH};
+    child[axis] = 0;
+    uint32_t first = child.x + child.y * STRIDE[1] + child.z * STRIDE[2];
+    uint32_t row = 0;
+    for (uint32_t k = 0; k < CONTREE_NODE_WIDTH; k++) {
+        row |= uint32_t((occupancy >> (first + k * STRIDE[axis])) & 1ULL) << k;
+    }
+    return row;
+}
+
+// Slab test of the ray against the box [low, high). t_in is where the ray enters and axis the face it enters through,
+// -1 when it starts inside. Returns false when the ray misses the box.
+static bool RayBox(glm::vec3 origin, glm::vec3 direction, glm::vec3 inverse, glm::ivec3 low, glm::ivec3 high, float &t_in, float &t_out, int8_t &axis) {
+    t_in = -std::numeric_limits<float>::infinity();
+    t_out = std::numeric_limits<float>::infinity();
+    axis = -1;
+    for (uint8_t a = 0; a < 3; a++) {
+        if (direction[a] == 0.0f) {
+            if (origin[a] < low[a] || origin[a] >= high[a]) return false;
+            continue;
+        }
+        float t0 = (low[a] - origin[a]) * inverse[a];
+        float t1 = (high[a] - origin[a]) * inverse[a];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > t_in) {
+            t_in = t0;
+            axis = a;
+        }
+        t_out = glm::min(t_out, t1);
+    }
+    return t_in <= t_out;
+}
+
+bool Raycast(VoxelManager &manager, glm::vec3 origin, glm::vec3 direction, float max_distance, RaycastHit &hit) {
+    if (manager.chunk_occupancy.chunks == nullptr || glm::length(direction) == 0.0f) return false;
+    direction = glm::normalize(direction);
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    glm::vec3 inverse;
+    for (uint8_t axis = 0; axis < 3; axis++) inverse[axis] = direction[axis] != 0.0f ? 1.0f / direction[axis] : infinity;
+
+    uint8_t major = 0;
+    if (glm::abs(direction.y) > glm::abs(direction[major])) major = 1;
+    if (glm::abs(direction.z) > glm::abs(direction[major])) major = 2;
+
+    // clip to the region the chunk directory covers
+    glm::ivec3 region_min = manager.chunk_occupancy.position * glm::ivec3(CHUNK_WIDTH);
+    glm::ivec3 region_max = region_min + glm::ivec3(manager.chunk_occupancy.size) * glm::ivec3(CHUNK_WIDTH);
+
+    float t;
+    float t_end;
+    int8_t entry_axis;
+    hit.steps = 0;
+    if (!RayBox(origin, direction, inverse, region_min, region_max, t, t_end, entry_axis)) return false;
+    if (t <= 0.0f) {
+        t = 0.0f;
+        entry_axis = -1;
+    }
+    t_end = glm::min(t_end, max_distance);
+    if (t > t_end) return false;
+
+    glm::vec3 point = origin + direction * t;
+    glm::ivec3 cell;
+    glm::ivec3 normal(0);
+    for (uint8_t axis = 0; axis < 3; axis++) cell[axis] = RayCell(point[axis], direction[axis]);
+    if (entry_axis >= 0) {
+        cell[entry_axis] = direction[entry_axis] > 0.0f ? region_min[entry_axis] : region_max[entry_axis] - 1;
+        normal[entry_axis] = direction[entry_axis] > 0.0f ? -1 : 1;
+    }
+
+    for (uint32_t step = 0; step < MAX_RAYCAST_STEPS; step++) {
+        hit.steps = step + 1;
+        if (glm::any(glm::lessThan(cell, region_min)) || glm::any(glm::greaterThanEqual(cell, region_max))) return false;
+
+        // find the biggest empty box around cell, or the solid voxel at it
+        glm::ivec3 chunk_position(FloorDiv(cell.x, CHUNK_WIDTH), FloorDiv(cell.y, CHUNK_WIDTH), FloorDiv(cell.z, CHUNK_WIDTH));
+        glm::ivec3 box_min = chunk_position * glm::ivec3(CHUNK_WIDTH);
+        glm::ivec3 box_max = box_min + glm::ivec3(CHUNK_WIDTH);
+
+        Relptr<AllocatedChunksBase> chunk = manager.GetChunkIndex(chunk_position);
+        if (chunk != nullptr && (chunk->flags & CHUNK_FLAG_EMPTY)) chunk = nullptr;
+        if (chunk != nullptr) {
+            // outside the solid bounds: jump to where the ray meets them, or skip the chunk if it never does
+            glm::ivec3 solid_min = box_min + glm::ivec3(UnpackChunkLocal(chunk->solid_min));
+            glm::ivec3 solid_max = box_min + glm::ivec3(UnpackChunkLocal(chunk->solid_max)) + 1;
+            if (glm::any(glm::lessThan(cell, solid_min)) || glm::any(glm::greaterThanEqual(cell, solid_max))) {
+                float t_in;
+                float t_out;
+                int8_t axis;
+                if (!RayBox(origin, direction, inverse, solid_min, solid_max, t_in, t_out, axis) || t_out < t) {
+                    chunk = nullptr;
+                } else if (t_in > t && axis >= 0) {
+                    if (t_in > t_end) return false;
+                    t = t_in;
+                    point = origin + direction * t;
+                    for (uint8_t a = 0; a < 3; a++) cell[a] = RayCell(point[a], direction[a]);
+                    cell[axis] = direction[axis] > 0.0f ? solid_min[axis] : solid_max[axis] - 1;
+                    normal = glm::ivec3(0);
+                    normal[axis] = direction[axis] > 0.0f ? -1 : 1;
+                    continue;
+                }
+            }
+        }
+        if (chunk == nullptr) {
+            // widen the skip to the largest empty pyramid cell around the chunk
+            int32_t level = manager.GetEmptyChunkLevel(chunk_position);
+            if (level > 0) {
+                int32_t width = CHUNK_WIDTH << (CHUNK_PYRAMID_SHIFT * level);
+                box_min = region_min + (cell - region_min) / width * width;
+                box_max = box_min + glm::ivec3(width);
+            }
+        } else if (uint8_t distance = manager.GetChunkDistance(chunk, glm::uvec3(cell - box_min)); distance > 1 || (distance == 1 && (chunk->flags & CHUNK_FLAG_BRICK))) {
+            // nothing solid within distance - 1 cells, skip the whole block of cells around the ray's cell. bricks have
+            // no tree to find an empty cell in, so they take single cells here as well
+            glm::ivec3 distance_cell = (cell - box_min) / int32_t(CHUNK_DISTANCE_CELL_WIDTH);
+            glm::ivec3 low = glm::max(distance_cell - int32_t(distance) + 1, glm::ivec3(0));
+            glm::ivec3 high = glm::min(distance_cell + int32_t(distance), glm::ivec3(CHUNK_DISTANCE_WIDTH));
+            box_max = box_min + high * int32_t(CHUNK_DISTANCE_CELL_WIDTH);
+            box_min = box_min + low * int32_t(CHUNK_DISTANCE_CELL_WIDTH);
+        } else if (chunk->flags & CHUNK_FLAG_BRICK) {
+            Voxel voxel = manager.GetVoxel(chunk, glm::uvec3(cell - box_min));
+            if (voxel.solid()) {
+                hit.position = cell;
+                hit.normal = normal;
+                hit.distance = t;
+                hit.voxel = voxel;
+                return true;
+            }
+            box_min = cell;
+            box_max = cell + 1;
+        } else {
+            const ContreeNode *node = chunk->contree_node;
+            glm::uvec3 local = cell - box_min;
+            uint32_t child_width = CHUNK_WIDTH;
+            for (uint8_t depth = 0; depth < CONTREE_MAX_DEPTH; depth++) {
+                child_width /= CONTREE_NODE_WIDTH;
+                glm::uvec3 child = (local / child_width) % uint32_t(CONTREE_NODE_WIDTH);
+                uint32_t index = child.x + child.y * CONTREE_NODE_WIDTH + child.z * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+
+                glm::ivec3 node_min = box_min;
+                box_min = node_min + glm::ivec3(child * child_width);
+                box_max = box_min + glm::ivec3(child_width);
+
+                if (!((node->occupancyMask >> index) & 1ULL)) {
+                    // stretch the empty cell over the clear bits that follow it along the major axis
+                    uint32_t row = OccupancyRow(node->occupancyMask, child, major);
+                    uint32_t k = child[major];
+                    if (direction[major] > 0.0f) {
+                        uint32_t end = k + 1;
+                        while (end < CONTREE_NODE_WIDTH && !((row >> end) & 1)) end++;
+                        box_max[major] = node_min[major] + int32_t(end * child_width);
+                    } else {
+                        uint32_t start = k;
+                        while (start > 0 && !((row >> (start - 1)) & 1)) start--;
+                        box_min[major] = node_min[major] + int32_t(start * child_width);
+                    }
+                    break;
+                }
+
+                if ((node->isVoxelMask >> index) & 1ULL) {
+                    hit.position = cell;
+                    hit.normal = normal;
+                    hit.distance = t;
+                    hit.voxel = node->voxel_data[index];
+                    return true;
+                }
+                node = node->child_nodes[index];
+            }
+        }
+
+        // leave the box through its nearest exit face
+        float t_exit = infinity;
+        uint8_t exit_axis = 0;
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            if (direction[axis] == 0.0f) continue;
+            float boundary = float(direction[axis] > 0.0f ? box_max[axis] : box_min[axis]);
+            float t_axis = (boundary - origin[axis]) * inverse[axis];
+            if (t_axis < t_exit) {
+                t_exit = t_axis;
+                exit_axis = axis;
+            }
+        }
+        if (t_exit > t_end) return false;
+
+        t = glm::max(t, t_exit);
+        point = origin + direction * t;
+        for (uint8_t axis = 0; axis < 3; axis++) cell[axis] = RayCell(point[axis], direction[axis]);
+        // the exit axis is set exactly, rounding must never leave the ray in the box it just left
+        cell[exit_axis] = direction[exit_axis] > 0.0f ? box_max[exit_axis] : box_min[exit_axis] - 1;
+        normal = glm::ivec3(0);
+        normal[exit_axis] = direction[exit_axis] > 0.0f ? -1 : 1;
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+
+#include "voxelmanager.h"
+
+struct RaycastHit {
+    glm::ivec3 position{}; // the solid voxel that was hit
+    glm::ivec3 normal{};   // outward normal of the face the ray entered through, zero when it started inside the voxel
+    float distance = 0.0f; // along the normalized direction
+    Voxel voxel{};
+    uint32_t steps = 0;    // empty boxes crossed plus the final descent, also set on a miss
+};
+
+// Finds the first solid voxel along a ray within max_distance. Air is crossed one empty cell at a time instead of one
+// voxel at a time: the walk stops at the first clear bit of a node's occupancy mask, and that cell is stretched along
+// the ray's major axis over the run of clear bits after it. Missing and empty chunks are skipped whole, in other chunks
+// the ray jumps straight to the solid bounds.
+bool Raycast(VoxelManager &manager, glm::vec3 origin, glm::vec3 direction, float max_distance, RaycastHit &hit);
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "worldfile.h"
+
+#include <fstream>
+
+static uint64_t AlignSection(uint64_t offset) {
+    return (offset + WORLD_FILE_ALIGNMENT - 1) / WORLD_FILE_ALIGNMENT * WORLD_FILE_ALIGNMENT;
+}
+
+template<typename T>
+static void WriteSection(std::ofstream &file, uint64_t offset, std::span<const T> data) {
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size_bytes()));
+}
+
+template<typename T>
+static bool ReadSection(std::ifstream &file, uint64_t offset, std::vector<T> &data, uint64_t count) {
+    data.resize(count, T{});
+    if (count == 0) return true; // an empty trailing section may start past the end of the file
+    file.seekg(static_cast<std::streamoff>(offset));
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(count * sizeof(T))));
+}
+
+bool WriteWorldFile(const std::string &path, uint32_t flags, std::span<const ContreeNode> nodes, std::span<const Chunk> chunks,
+                    std::span<const Material> materials, const ChunkPositionsHeader &directory, std::span<const uint32_t> directory_chunks,
+                    std::span<const uint16_t> bricks) {
+    WorldFileHeader header;
+    header.flags = flags;
+    header.directory = directory;
+
+    header.node_count = nodes.size();
+    header.chunk_count = chunks.size();
+    header.material_count = materials.size();
+    header.directory_count = directory_chunks.size();
+    header.brick_count = bricks.size();
+
+    header.node_offset = AlignSection(sizeof(WorldFileHeader));
+    header.chunk_offset = AlignSection(header.node_offset + nodes.size_bytes());
+    header.material_offset = AlignSection(header.chunk_offset + chunks.size_bytes());
+    header.directory_offset = AlignSection(header.material_offset + materials.size_bytes());
+    header.brick_offset = AlignSection(header.directory_offset + directory_chunks.size_bytes());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteSection(file, header.node_offset, nodes);
+    WriteSection(file, header.chunk_offset, chunks);
+    WriteSection(file, header.material_offset, materials);
+    WriteSection(file, header.directory_offset, directory_chunks);
+    WriteSection(file, header.brick_offset, bricks);
+    return static_cast<bool>(file);
+}
+
+bool ReadWorldFile(const std::string &path, WorldFileHeader &header, std::vector<ContreeNode> &nodes, std::vector<Chunk> &chunks,
+                   std::vector<Material> &materials, std::vector<uint32_t> &directory_chunks, std::vector<uint16_t> &bricks) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+
+    if (size < sizeof(WorldFileHeader)) return false;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (header.magic != WORLD_FILE_MAGIC || header.version != WORLD_FILE_VERSION || header.node_size != sizeof(ContreeNode)) return false;
+
+    ChunkPositionsHeader directory = header.directory;
+    uint64_t directory_plane = uint64_t(directory.size.x) * directory.size.y; // ChunkPositionsHeader::get_size is 32 bit
+    if (directory_plane > UINT32_MAX || directory_plane * directory.size.z > UINT32_MAX) return false;
+    if (header.directory_count != directory_plane * directory.size.z) return false;
+
+    // written so a hostile offset or count cannot wrap around, empty sections are never read
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t stride) { return count == 0 || (offset <= size && count <= (size - offset) / stride); };
+    if (!fits(header.node_offset, header.node_count, sizeof(ContreeNode))) return false;
+    if (!fits(header.chunk_offset, header.chunk_count, sizeof(Chunk))) return false;
+    if (!fits(header.material_offset, header.material_count, sizeof(Material))) return false;
+    if (!fits(header.directory_offset, header.directory_count, sizeof(uint32_t))) return false;
+    if (!fits(header.brick_offset, header.brick_count, sizeof(uint16_t)) || header.brick_count % CHUNK_BRICK_VOXELS != 0) return false;
+
+    return ReadSection(file, header.node_offset, nodes, header.node_count) &&
+           ReadSection(file, header.chunk_offset, chunks, header.chunk_count) &&
+           ReadSection(file, header.material_offset, materials, header.material_count) &&
+           ReadSection(file, header.directory_offset, directory_chunks, header.directory_count) &&
+           ReadSection(file, header.brick_offset, bricks, header.brick_count);
+}
+
+void ReorderNodes(std::vector<ContreeNode> &nodes, std::span<Chunk> chunks, std::span<Relptr<ContreeDataBase>> detached) {
+    std::vector<uint32_t> remap(nodes.size(), POINTER_EMPTY);
+    std::vector<ContreeNode> ordered;
+    ordered.reserve(nodes.size());
+    std::vector<uint32_t> stack; // new indices whose children still need placing
+
+    // places a node on first sight and returns its new index
+    auto place = [&](uint32_t index) {
+        if (remap[index] != POINTER_EMPTY) return remap[index];
+        remap[index] = static_cast<uint32_t>(ordered.size());
+        ordered.push_back(nodes[index]);
+        stack.push_back(remap[index]);
+        return remap[index];
+    };
+
+    // places a whole tree and points root at its new index
+    auto place_tree = [&](Relptr<ContreeDataBase> &root) {
+        if (root == nullptr) return;
+        root = place(root.offset);
+
+        while (!stack.empty()) {
+            uint32_t node = stack.back();
+            stack.pop_back();
+            if (ordered[node].isVoxelMask == CONTREE_VOXEL_MASK_FULL) continue;
+
+            // all children are placed before any of them is expanded, which keeps siblings together
+            for (size_t i = 0; i < CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH; i++) {
+                if (ordered[node].IsVoxel(i)) continue;
+                uint32_t child = place(ordered[node].child_nodes[i].offset);
+                ordered[node].child_nodes[i] = child;
+            }
+        }
+    };
+
+    for (Chunk &chunk : chunks) place_tree(chunk.contree_node);
+    for (Relptr<ContreeDataBase> &root : detached) place_tree(root);
+
+    nodes = std::move(ordered);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <vector>
+
+#include "voxel.h"
+
+static constexpr uint32_t WORLD_FILE_MAGIC = 0x44575856; // "VXWD"
+static constexpr uint32_t WORLD_FILE_VERSION = 3; // 2: chunk summaries, 3: bricks
+static constexpr uint64_t WORLD_FILE_ALIGNMENT = 4096; // sections start on page boundaries so the file can be mapped as is
+static constexpr uint32_t WORLD_FLAG_SHARED_NODES = 0b00000000000000000000000000000001; // identical subtrees are stored once
+
+// A compiled world is this header followed by the node, chunk, material, chunk directory and brick arrays, each stored
+// exactly as VoxelManager and the GPU buffers hold them.
+struct WorldFileHeader {
+    uint32_t magic = WORLD_FILE_MAGIC;
+    uint32_t version = WORLD_FILE_VERSION;
+    uint32_t flags = 0;
+    uint32_t node_size = sizeof(ContreeNode); // catches files written before a node layout change
+
+    uint64_t node_offset = 0;
+    uint64_t node_count = 0;
+    uint64_t chunk_offset = 0;
+    uint64_t chunk_count = 0;
+    uint64_t material_offset = 0;
+    uint64_t material_count = 0;
+    uint64_t directory_offset = 0;
+    uint64_t directory_count = 0;
+    uint64_t brick_offset = 0;
+    uint64_t brick_count = 0; // voxels, CHUNK_BRICK_VOXELS per brick
+
+    ChunkPositionsHeader directory{};
+};
+
+bool WriteWorldFile(const std::string &path, uint32_t flags, std::span<const ContreeNode> nodes, std::span<const Chunk> chunks,
+                    std::span<const Material> materials, const ChunkPositionsHeader &directory, std::span<const uint32_t> directory_chunks,
+                    std::span<const uint16_t> bricks);
+
+// Validates the header against the file size before touching any of the output vectors.
+bool ReadWorldFile(const std::string &path, WorldFileHeader &header, std::vector<ContreeNode> &nodes, std::vector<Chunk> &chunks,
+                   std::vector<Material> &materials, std::vector<uint32_t> &directory_chunks, std::vector<uint16_t> &bricks);
+
+// Rewrites nodes depth first from each chunk root in chunk order: a chunk's nodes end up contiguous, parents come before
+// their children and the 64 children of a node sit next to each other. Nodes no chunk reaches are dropped, nodes with
+// several parents (deduplicated worlds) are placed on their first visit. Trees under detached roots follow the chunks.
+void ReorderNodes(std::vector<ContreeNode> &nodes, std::span<Chunk> chunks, std::span<Relptr<ContreeDataBase>> detached = {});
\ No newline at end of file
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "voxelmanager.h"
+
+// Builds the 640^3 test scene (terrain, lake, village, trees, peaks, floating island) into an empty VoxelManager.
+// Used by WorldCompiler and as the fallback when no compiled world is found.
+void GenerateTestWorld(VoxelManager &vm);
\ No newline at end of file
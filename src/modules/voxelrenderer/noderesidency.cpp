@@ -0,0 +1,209 @@
+#include "noderesidency.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "glm/geometric.hpp"
+
+static constexpr uint32_t EVALUATE_FRAMES = 30;      // priorities are redone at least this often
+static constexpr uint32_t VISIBLE_FRAMES = 120;      // a chunk counts as seen for this long after a ray reached it
+static constexpr float VISIBLE_BONUS = 8.0f;         // chunks, how much closer a seen chunk is treated as
+
+void NodeResidency::Init(HeapBuffer *heap, size_t budget) {
+    this->heap = heap;
+    SetBudget(budget);
+}
+
+void NodeResidency::SetBudget(size_t bytes) {
+    budget = std::max(bytes, PAGE_BYTES);
+    evaluated_pages = SIZE_MAX;
+    if (budget / PAGE_BYTES >= slot_pages.size()) return; // the pool grows into it on the next Sync
+
+    // a smaller pool, start over from nothing resident. nodes still on their way would land in freed space
+    stream.Cancel();
+    std::fill(page_table.begin(), page_table.end(), PAGE_MISSING);
+    upload_table.MarkAll(page_table.size());
+    if (slots.capacity > 0) heap->Free(slots.offset);
+    slots = {};
+    slot_pages.clear();
+    free_slots.clear();
+    evictable.clear();
+}
+
+void NodeResidency::MarkChunkVisible(uint32_t chunk) {
+    if (chunk < chunk_seen.size()) chunk_seen[chunk] = frame;
+}
+
+// Wants the pages of the nearest chunks first until the budget is full. Chunks a ray reached lately are moved closer.
+void NodeResidency::Evaluate(VoxelManager &vm, glm::vec3 camera) {
+    size_t budget_slots = std::max<size_t>(budget / PAGE_BYTES, 1);
+
+    std::vector<std::pair<float, uint32_t>> order;
+    order.reserve(vm.allocated_chunks.size());
+    for (uint32_t i = 0; i < vm.allocated_chunks.size(); i++) {
+        const Chunk &chunk = vm.allocated_chunks[i];
+        if (chunk.contree_node.offset >= vm.contree_data.size() || (chunk.flags & CHUNK_FLAG_BRICK)) continue; // bricks are always resident
+        glm::vec3 center = (glm::vec3(chunk.position) + 0.5f) * float(CHUNK_WIDTH);
+        float distance = glm::length(center - camera) / float(CHUNK_WIDTH);
+        if (chunk_seen[i] != 0 && frame - chunk_seen[i] < VISIBLE_FRAMES) distance -= VISIBLE_BONUS;
+        order.push_back({distance, i});
+    }
+    std::sort(order.begin(), order.end());
+
+    wanted.clear();
+    std::vector<uint32_t> stack;
+    for (const auto &[distance, i] : order) {
+        if (wanted.size() >= budget_slots) break;
+        stack.push_back(vm.allocated_chunks[i].contree_node.offset);
+        while (!stack.empty()) {
+            uint32_t node = stack.back();
+            stack.pop_back();
+            uint32_t page = static_cast<uint32_t>(node / PAGE_NODES);
+            if (last_wanted[page] != frame) {
+                last_wanted[page] = frame;
+                wanted.push_back(page);
+            }
+
+            const ContreeNode &contree = vm.contree_data[node];
+            for (uint64_t pointers = ~contree.isVoxelMask; pointers != 0; pointers &= pointers - 1) {
+                uint32_t child = contree.child_nodes[std::countr_zero(pointers)].offset;
+                if (child < vm.contree_data.size()) stack.push_back(child);
+            }
+        }
+    }
+    if (wanted.size() > budget_slots) wanted.resize(budget_slots); // the last chunk only partly fits
+
+    // resident pages nobody wants now, the one wanted longest ago goes first
+    evictable.clear();
+    for (uint32_t page : slot_pages) {
+        if (page != PAGE_MISSING && last_wanted[page] != frame) evictable.push_back(page);
+    }
+    std::sort(evictable.begin(), evictable.end(), [this](uint32_t a, uint32_t b) { return last_wanted[a] > last_wanted[b]; });
+
+    wanted_cursor = 0;
+    evaluated_frame = frame;
+}
+
+void NodeResidency::Load(VoxelManager &vm, uint32_t page, uint32_t slot) {
+    page_table[page] = slot;
+    slot_pages[slot] = page;
+    upload_table.Mark(page);
+
+    size_t first = size_t(page) * PAGE_NODES;
+    stream.Add(vm.contree_data.data() + first, static_cast<uint32_t>(first), std::min(PAGE_NODES, vm.contree_data.size() - first), slots.offset + size_t(slot) * PAGE_BYTES);
+}
+
+void NodeResidency::UploadNodes(VoxelManager &vm, size_t begin, size_t end) {
+    while (begin < end) {
+        size_t page = begin / PAGE_NODES;
+        size_t first = page * PAGE_NODES;
+        size_t page_end = std::min(end, first + PAGE_NODES);
+        uint32_t slot = page_table[page];
+        if (slot != PAGE_MISSING) {
+            stream.Add(vm.contree_data.data() + begin, static_cast<uint32_t>(begin), page_end - begin, slots.offset + size_t(slot) * PAGE_BYTES + (begin - first) * sizeof(ContreeNode));
+        }
+        begin = page_end;
+    }
+}
+
+bool NodeResidency::Sync(VoxelManager &vm, glm::vec3 camera, size_t max_page_uploads) {
+    frame++;
+    bool moved = false;
+    size_t node_count = vm.contree_data.size();
+    size_t page_count = (node_count + PAGE_NODES - 1) / PAGE_NODES;
+
+    // pages past the end (CompactNodes) give their slots back
+    for (size_t page = page_count; page < page_table.size(); page++) {
+        if (page_table[page] == PAGE_MISSING) continue;
+        slot_pages[page_table[page]] = PAGE_MISSING;
+        free_slots.push_back(page_table[page]);
+    }
+    if (page_count > page_table.size()) upload_table.Mark(page_table.size(), page_count);
+    page_table.resize(page_count, PAGE_MISSING);
+    last_wanted.resize(page_count, 0);
+    moved |= heap->Fit(table, std::max<size_t>(page_count, 1) * sizeof(uint32_t));
+
+    // the pool grows up to the budget, never past what the world has pages for
+    size_t budget_slots = std::max<size_t>(budget / PAGE_BYTES, 1);
+    size_t needed = std::min(budget_slots, std::max<size_t>(page_count, 1));
+    if (needed > slot_pages.size()) {
+        size_t count = std::min(budget_slots, std::max(needed, slot_pages.size() * 2));
+        size_t bytes = count * PAGE_BYTES;
+        slots.offset = slots.capacity == 0 ? heap->Allocate(bytes) : heap->Reallocate(slots.offset, slots.size, bytes);
+        slots.capacity = bytes;
+        slots.size = bytes;
+        for (size_t slot = count; slot-- > slot_pages.size();) free_slots.push_back(static_cast<uint32_t>(slot));
+        slot_pages.resize(count, PAGE_MISSING);
+        moved = true;
+    }
+
+    size_t chunk_count = vm.allocated_chunks.size();
+    chunk_seen.resize(chunk_count, 0);
+
+    glm::ivec3 camera_chunk = glm::ivec3(glm::floor(camera / float(CHUNK_WIDTH)));
+    if (camera_chunk != evaluated_chunk || page_count != evaluated_pages || frame - evaluated_frame >= EVALUATE_FRAMES) {
+        Evaluate(vm, camera);
+        evaluated_chunk = camera_chunk;
+        evaluated_pages = page_count;
+    }
+
+    for (const DirtyRanges::Span &span : vm.upload_nodes.Take(node_count, 4)) {
+        UploadNodes(vm, span.begin, span.end);
+    }
+
+    for (size_t loads = 0; wanted_cursor < wanted.size() && loads < max_page_uploads; wanted_cursor++) {
+        uint32_t page = wanted[wanted_cursor];
+        if (page >= page_count || page_table[page] != PAGE_MISSING) continue;
+
+        uint32_t slot;
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            // skip what went missing or became wanted again since the evaluation
+            while (!evictable.empty() && (evictable.back() >= page_count || page_table[evictable.back()] == PAGE_MISSING || last_wanted[evictable.back()] == evaluated_frame)) {
+                evictable.pop_back();
+            }
+            if (evictable.empty()) break; // every slot holds a page wanted more
+            uint32_t evicted = evictable.back();
+            evictable.pop_back();
+            slot = page_table[evicted];
+            page_table[evicted] = PAGE_MISSING;
+            upload_table.Mark(evicted);
+            // dirty nodes of the evicted page queued above would race the load in the same dispatch
+            stream.Discard(slots.offset + size_t(slot) * PAGE_BYTES, PAGE_BYTES);
+        }
+        Load(vm, page, slot);
+        loads++;
+    }
+
+    std::vector<DirtyRanges::Span> spans = upload_table.Take(page_count);
+    std::vector<BufferRange> ranges(spans.size());
+    for (size_t i = 0; i < spans.size(); i++) {
+        ranges[i] = {spans[i].begin * sizeof(uint32_t), (spans[i].end - spans[i].begin) * sizeof(uint32_t)};
+    }
+    heap->Upload(page_table.data(), ranges, table.offset);
+    table.size = page_count * sizeof(uint32_t);
+
+    // root lods for the fallback, cheap enough to compare every frame
+    DirtyRanges upload_lods;
+    if (chunk_count > chunk_lods.size()) upload_lods.Mark(chunk_lods.size(), chunk_count);
+    chunk_lods.resize(chunk_count, 0);
+    for (size_t i = 0; i < chunk_count; i++) {
+        uint32_t root = vm.allocated_chunks[i].contree_node.offset;
+        uint32_t lod = root < node_count ? vm.contree_data[root].lod_voxel.data : 0;
+        if (lod == chunk_lods[i]) continue;
+        chunk_lods[i] = lod;
+        upload_lods.Mark(i);
+    }
+    moved |= heap->Fit(lods, std::max<size_t>(chunk_count, 1) * sizeof(uint32_t));
+    spans = upload_lods.Take(chunk_count, 16);
+    ranges.resize(spans.size());
+    for (size_t i = 0; i < spans.size(); i++) {
+        ranges[i] = {spans[i].begin * sizeof(uint32_t), (spans[i].end - spans[i].begin) * sizeof(uint32_t)};
+    }
+    heap->Upload(chunk_lods.data(), ranges, lods.offset);
+    lods.size = chunk_count * sizeof(uint32_t);
+
+    return moved;
+}
\ No newline at end of file
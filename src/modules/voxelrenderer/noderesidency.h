@@ -0,0 +1,65 @@
+#pragma once
+
+#include "modules/renderer/resources/heapbuffer.h"
+#include "modules/voxel/voxelmanager.h"
+#include "nodestream.h"
+#include "dirtyranges/dirtyranges.hpp"
+#include "glm/vec3.hpp"
+
+#include <vector>
+
+// Keeps the part of contree_data the camera needs in a fixed pool of GPU page slots, the whole world stays in system
+// memory. Nodes are grouped into pages of PAGE_NODES by index, the page table maps every page to its slot or to
+// PAGE_MISSING. Pages are wanted by the chunks whose trees use them, nearest and recently seen chunks first, until the
+// budget is full. A wanted page that is not resident takes a free slot or the one of the page wanted least recently.
+// Rays that reach a missing page trace the chunk from its distance field instead (TraceFallback in raytrace.slangh).
+// Nodes are not copied into their slots directly, they go through stream and the nodedecode pass.
+class NodeResidency {
+    public:
+        static constexpr size_t PAGE_NODES = 256; // mirrors PAGE_NODES in voxel.slangh
+        static constexpr size_t PAGE_BYTES = PAGE_NODES * sizeof(ContreeNode);
+        static constexpr uint32_t PAGE_MISSING = UINT32_MAX;
+        static constexpr size_t DEFAULT_BUDGET = 512 * 1024 * 1024;
+
+        void Init(HeapBuffer *heap, size_t budget = DEFAULT_BUDGET);
+        void SetBudget(size_t bytes); // bytes of node pages on the GPU, shrinking it starts over from nothing resident
+        size_t GetBudget(void) const { return budget; }
+
+        // Uploads what changed in resident pages and makes up to max_page_uploads wanted pages resident. The page
+        // table and chunk lods are brought up to date. Returns whether a region moved in the heap.
+        bool Sync(VoxelManager &vm, glm::vec3 camera, size_t max_page_uploads);
+
+        // a ray reached the chunk lately (the visibility readback), it is preferred over chunks at the same distance for a while
+        void MarkChunkVisible(uint32_t chunk);
+
+        size_t GetPageCount(void) const { return page_table.size(); }
+        size_t GetResidentPages(void) const { return slot_pages.size() - free_slots.size(); }
+
+        HeapRegion slots{};  // the page pool, PAGE_BYTES per slot
+        HeapRegion table{};  // a word per page
+        HeapRegion lods{};   // the root lod voxel of every chunk, what the fallback draws
+        NodeStream stream{}; // the nodes Sync sends, submitted by the caller once the heap layout is final
+    private:
+        void Evaluate(VoxelManager &vm, glm::vec3 camera);
+        void Load(VoxelManager &vm, uint32_t page, uint32_t slot);
+        void UploadNodes(VoxelManager &vm, size_t begin, size_t end); // resident nodes of [begin, end)
+
+        HeapBuffer *heap = nullptr;
+        size_t budget = DEFAULT_BUDGET;
+        uint32_t frame = 1;
+
+        std::vector<uint32_t> page_table{};   // page -> slot
+        std::vector<uint32_t> slot_pages{};   // slot -> page, PAGE_MISSING when free
+        std::vector<uint32_t> free_slots{};
+        std::vector<uint32_t> last_wanted{};  // frame of the last evaluation that wanted the page
+        std::vector<uint32_t> chunk_seen{};   // frame a ray last reached the chunk
+        std::vector<uint32_t> chunk_lods{};
+        DirtyRanges upload_table{};
+
+        std::vector<uint32_t> wanted{};   // pages of the last evaluation, most important first
+        size_t wanted_cursor = 0;         // pages before it are resident
+        std::vector<uint32_t> evictable{}; // resident pages the last evaluation didn't want, least recently wanted last
+        glm::ivec3 evaluated_chunk{INT32_MIN};
+        size_t evaluated_pages = 0;
+        uint32_t evaluated_frame = 0;
+};
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "nodestream.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+static void PutVarint(std::vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+static uint32_t GetVarint(const uint8_t *data, size_t &at) {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = data[at++];
+        value |= uint32_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+static void PutMask(std::vector<uint8_t> &out, uint64_t mask) {
+    for (int i = 0; i < 8; i++) out.push_back(uint8_t(mask >> (i * 8)));
+}
+
+static uint64_t GetMask(const uint8_t *data, size_t &at) {
+    uint64_t mask = 0;
+    for (int i = 0; i < 8; i++) mask |= uint64_t(data[at++]) << (i * 8);
+    return mask;
+}
+
+void NodeStream::Create(TypedBuffer<uint32_t> *buffer) {
+    this->buffer = buffer;
+    if (buffer->GetSize() < HEADER_WORDS) buffer->SetSize(HEADER_WORDS);
+}
+
+void NodeStream::EncodeNode(const ContreeNode &node, uint32_t index, std::vector<uint8_t> &out) {
+    uint64_t occupancy = node.occupancyMask;
+    uint64_t voxels = node.isVoxelMask & occupancy;
+
+    uint8_t header = 0;
+    if (occupancy == UINT64_MAX) header |= OCCUPANCY_FULL;
+    if (occupancy == 0) header |= OCCUPANCY_EMPTY;
+    if (voxels == occupancy) header |= ALL_VOXELS;
+    else if (voxels == 0) header |= ALL_POINTERS;
+
+    out.push_back(header);
+    if (!(header & (OCCUPANCY_FULL | OCCUPANCY_EMPTY))) PutMask(out, occupancy);
+    if (!(header & (ALL_VOXELS | ALL_POINTERS))) PutMask(out, voxels);
+
+    // neighbouring voxels mostly share their material and most of their color, the lod is their average
+    uint32_t previous = node.lod_voxel.data;
+    PutVarint(out, previous);
+    for (uint64_t bits = occupancy; bits != 0; bits &= bits - 1) {
+        int child = std::countr_zero(bits);
+        if ((voxels >> child) & 1) {
+            uint32_t value = node.voxel_data[child].data;
+            PutVarint(out, value ^ previous);
+            previous = value;
+        } else {
+            uint32_t delta = node.child_nodes[child].offset - index; // children are mostly allocated right behind the parent
+            PutVarint(out, (delta << 1) ^ uint32_t(int32_t(delta) >> 31));
+        }
+    }
+}
+
+size_t NodeStream::DecodeNode(const uint8_t *data, uint32_t index, ContreeNode &node) {
+    size_t at = 0;
+    uint8_t header = data[at++];
+
+    uint64_t occupancy = header & OCCUPANCY_FULL ? UINT64_MAX : header & OCCUPANCY_EMPTY ? 0 : GetMask(data, at);
+    uint64_t voxels = header & ALL_VOXELS ? UINT64_MAX : header & ALL_POINTERS ? ~occupancy : GetMask(data, at) | ~occupancy;
+
+    node = {};
+    node.occupancyMask = occupancy;
+    node.isVoxelMask = voxels;
+    node.lod_voxel.data = GetVarint(data, at);
+
+    uint32_t previous = node.lod_voxel.data;
+    for (uint64_t bits = occupancy; bits != 0; bits &= bits - 1) {
+        int child = std::countr_zero(bits);
+        uint32_t coded = GetVarint(data, at);
+        if ((voxels >> child) & 1) {
+            previous ^= coded;
+            node.voxel_data[child].data = previous;
+        } else {
+            node.child_nodes[child].offset = index + ((coded >> 1) ^ (0u - (coded & 1)));
+        }
+    }
+    return at;
+}
+
+void NodeStream::Add(const ContreeNode *nodes, uint32_t first, size_t count, size_t destination) {
+    for (size_t done = 0; done < count; done += JOB_NODES) {
+        Job job{};
+        job.destination = static_cast<uint32_t>((destination + done * sizeof(ContreeNode)) / sizeof(uint32_t));
+        job.first = first + static_cast<uint32_t>(done);
+        job.count = static_cast<uint32_t>(std::min<size_t>(JOB_NODES, count - done));
+        job.offset = static_cast<uint32_t>(offsets.size());
+        jobs.push_back(job);
+
+        for (uint32_t i = 0; i < job.count; i++) {
+            offsets.push_back(static_cast<uint32_t>(data.size()));
+            EncodeNode(nodes[done + i], job.first + i, data);
+        }
+    }
+}
+
+void NodeStream::Submit() {
+    if (jobs.empty() || pending != 0) return;
+
+    uint32_t offsets_word = HEADER_WORDS + static_cast<uint32_t>(jobs.size()) * JOB_WORDS;
+    uint32_t data_word = offsets_word + static_cast<uint32_t>(offsets.size());
+    words.resize(data_word + (data.size() + 3) / 4);
+    words[0] = static_cast<uint32_t>(jobs.size());
+    words[1] = offsets_word;
+    words[2] = data_word;
+    words[3] = 0;
+    memcpy(words.data() + HEADER_WORDS, jobs.data(), jobs.size() * sizeof(Job));
+    memcpy(words.data() + offsets_word, offsets.data(), offsets.size() * sizeof(uint32_t));
+    words.back() = 0; // the padding of the last word
+    memcpy(words.data() + data_word, data.data(), data.size());
+
+    // uploaded whole, nothing to keep when it grows
+    if (words.size() > buffer->GetSize()) buffer->SetSize(std::max(words.size(), buffer->GetSize() * 2));
+    buffer->Upload(words);
+
+    pending = static_cast<uint32_t>(jobs.size());
+    jobs.clear();
+    offsets.clear();
+    data.clear();
+}
+
+void NodeStream::Cancel() {
+    jobs.clear();
+    offsets.clear();
+    data.clear();
+    pending = 0;
+}
+
+void NodeStream::Discard(size_t destination, size_t size) {
+    uint32_t first = static_cast<uint32_t>(destination / sizeof(uint32_t));
+    uint32_t last = static_cast<uint32_t>((destination + size) / sizeof(uint32_t));
+    // their nodes stay in offsets and data unreferenced until the next Submit clears them
+    std::erase_if(jobs, [first, last](const Job &job) { return job.destination >= first && job.destination < last; });
+}
+
+uint32_t NodeStream::TakeDispatch() {
+    uint32_t count = pending;
+    pending = 0;
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "modules/renderer/resources/buffer.h"
+#include "modules/voxel/voxelmanager.h"
+
+#include <vector>
+
+// Contree nodes travel to the GPU encoded and are expanded into the heap by the nodedecode pass. A node is a header byte,
+// the occupancy and voxel masks unless the header says they are trivial, its lod voxel and then its occupied children
+// only, as varints: voxels xor the voxel before them in the node, pointers zigzagged relative to the node's own index.
+// Air children, the mask bits under them and coverage are not sent, the shaders never read them.
+//
+// The buffer holds a header {job count, offsets word, data word, 0}, the jobs, the byte offset of every node in the data
+// and the data. A job decodes up to JOB_NODES consecutive nodes, a thread per node.
+class NodeStream {
+    public:
+        // mirror nodedecode.slang
+        static constexpr uint8_t OCCUPANCY_FULL = 1;
+        static constexpr uint8_t OCCUPANCY_EMPTY = 2;
+        static constexpr uint8_t ALL_VOXELS = 4;
+        static constexpr uint8_t ALL_POINTERS = 8;
+        static constexpr uint32_t JOB_NODES = 256;
+        static constexpr uint32_t HEADER_WORDS = 4;
+        static constexpr uint32_t JOB_WORDS = 4;
+
+        void Create(TypedBuffer<uint32_t> *buffer);
+
+        // nodes[0, count) are the nodes from index first on, decoded to byte offset destination of the heap
+        void Add(const ContreeNode *nodes, uint32_t first, size_t count, size_t destination);
+        // uploads what was added, for the next decode dispatch. while the last upload wait for it, nodes keep piling up
+        void Submit(void);
+        void Cancel(void); // drops everything not decoded yet, the heap space it was going to was freed
+        // drops the jobs not submitted yet that decode into the heap bytes [destination, destination + size), whose
+        // space was handed to other nodes. the dispatch runs its jobs in no order, a stale job could land after the new one
+        void Discard(size_t destination, size_t size);
+        uint32_t TakeDispatch(void); // jobs of the upload to decode now, 0 once taken
+
+        static void EncodeNode(const ContreeNode &node, uint32_t index, std::vector<uint8_t> &out);
+        static size_t DecodeNode(const uint8_t *data, uint32_t index, ContreeNode &node); // what the shader does, returns the bytes read
+
+        size_t GetEncodedBytes(void) const { return data.size(); }   // added since the last Submit
+        size_t GetNodeCount(void) const { return offsets.size(); }
+    private:
+        struct Job {
+            uint32_t destination; // heap word
+            uint32_t first;
+            uint32_t count;
+            uint32_t offset;      // of the job's first node in offsets
+        };
+
+        TypedBuffer<uint32_t> *buffer = nullptr;
+        std::vector<Job> jobs{};
+        std::vector<uint32_t> offsets{};
+        std::vector<uint8_t> data{};
+        std::vector<uint32_t> words{};
+        uint32_t pending = 0;
+};
\ No newline at end of file
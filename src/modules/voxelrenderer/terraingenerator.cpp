@@ -0,0 +1,117 @@
+#include "terraingenerator.h"
+#include "modules/voxel/voxelimport.h"
+
+#include "shaders/terraingen.h"
+
+#include <algorithm>
+
+// the shader reads the settings as these words, see TerrainSettings in terraingen.slang
+static_assert(sizeof(NoiseSettings) == 6 * sizeof(uint32_t));
+static_assert(sizeof(TerrainSettings) == 24 * sizeof(uint32_t));
+static_assert(sizeof(Voxel) == sizeof(uint32_t));
+
+static constexpr size_t CHUNK_VOXELS = size_t(CHUNK_WIDTH) * CHUNK_WIDTH * CHUNK_WIDTH;
+
+static Voxel TerrainVoxel(uint8_t r, uint8_t g, uint8_t b) {
+    Voxel voxel{};
+    voxel.set_rgb(r, g, b);
+    voxel.set_solid(true);
+    return voxel;
+}
+
+void TerrainGenerator::Init(Renderer &renderer, VoxelManager &vm) {
+    settings.grass = TerrainVoxel(8, 24, 5);
+    settings.dirt = TerrainVoxel(16, 10, 5);
+    settings.stone = TerrainVoxel(14, 14, 15);
+    settings.sand = TerrainVoxel(27, 23, 13);
+    settings.snow = TerrainVoxel(29, 30, 31);
+    settings.water = TerrainVoxel(3, 12, 28);
+
+    Material liquid;
+    liquid.transparency = 0.6f;
+    liquid.friction = 0.1f;
+    liquid.flags = MATERIAL_FLAG_LIQUID;
+    settings.water.set_material(vm.AddMaterial(liquid));
+
+    settingsBuffer = renderer.CreateResource<TypedBuffer<TerrainSettings>>();
+    settingsBuffer->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    settingsBuffer->SetSize(1);
+
+    chunks = renderer.CreateResource<TypedBuffer<glm::ivec4>>();
+    chunks->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    chunks->SetSize(BATCH_CHUNKS);
+
+    // the solid counts, then the blocks
+    output = renderer.CreateResource<TypedBuffer<uint32_t>>();
+    output->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    output->SetSize(BATCH_CHUNKS + BATCH_CHUNKS * CHUNK_VOXELS);
+
+    ComputePass *generatePass = renderer.CreateShaderPass<ComputePass>();
+    generatePass->spirv = terraingen_spirv;
+    generatePass->spirv_size = terraingen_spirv_sizeInBytes/4;
+    generatePass->threadcount = {8, 8, 1};
+    generatePass->readonly_storage_buffers.push_back(settingsBuffer);
+    generatePass->readonly_storage_buffers.push_back(chunks);
+    generatePass->readwrite_storage_buffers.push_back(output);
+    generatePass->dispatchFunc = [this](const ComputePass& pass) {
+        if (state != State::Dispatch || dispatched) return glm::uvec3(0, 0, 0);
+        dispatched = true;
+        return glm::uvec3(CHUNK_WIDTH / pass.threadcount.x, CHUNK_WIDTH / pass.threadcount.y, batch.size());
+    };
+    generatePass->Create();
+}
+
+void TerrainGenerator::QueueColumns(glm::ivec2 first, glm::ivec2 count) {
+    int32_t layers = (settings.GetMaxHeight() + CHUNK_WIDTH - 1) / CHUNK_WIDTH;
+    for (int32_t z = first.y; z < first.y + count.y; z++)
+        for (int32_t x = first.x; x < first.x + count.x; x++)
+            for (int32_t y = 0; y < layers; y++)
+                Queue(glm::ivec3(x, y, z));
+}
+
+void TerrainGenerator::Queue(glm::ivec3 chunk) {
+    queue.push_back(chunk);
+}
+
+void TerrainGenerator::Process(VoxelManager &vm) {
+    // the pass ran in this frame's command buffer, the readback is recorded into the next one behind it
+    if (state == State::Dispatch && dispatched) {
+        state = State::Download;
+        output->DownloadAsync(BATCH_CHUNKS + batch.size() * CHUNK_VOXELS, 0, [this](const uint32_t *words, size_t count) {
+            solid.assign(words, words + batch.size());
+            ready.resize(count - BATCH_CHUNKS);
+            for (size_t i = 0; i < ready.size(); i++) ready[i].data = words[BATCH_CHUNKS + i];
+            readBack = true;
+        });
+    }
+
+    if (readBack) {
+        // air chunks are dropped, the blocks of the others are moved together
+        std::vector<glm::ivec3> positions;
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (solid[i] == 0) continue;
+            if (positions.size() != i) std::copy_n(ready.begin() + i * CHUNK_VOXELS, CHUNK_VOXELS, ready.begin() + positions.size() * CHUNK_VOXELS);
+            positions.push_back(batch[i]);
+        }
+        if (!positions.empty()) ImportDenseChunks(vm, positions, ready.data());
+        readBack = false;
+        state = State::Idle;
+    }
+
+    if (state != State::Idle || queue.empty()) return;
+
+    batch.clear();
+    std::vector<glm::ivec4> positions;
+    while (!queue.empty() && batch.size() < BATCH_CHUNKS) {
+        batch.push_back(queue.front());
+        positions.push_back(glm::ivec4(queue.front(), 0));
+        queue.pop_front();
+    }
+
+    uint32_t counts[BATCH_CHUNKS] = {};
+    settingsBuffer->Upload(&settings, 1);
+    chunks->Upload(positions);
+    output->Upload(counts, BATCH_CHUNKS);
+    dispatched = false;
+    state = State::Dispatch;
+}
\ No newline at end of file
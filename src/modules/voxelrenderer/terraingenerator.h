@@ -0,0 +1,81 @@
+#pragma once
+
+#include "modules/renderer/renderer.h"
+#include "modules/renderer/resources/buffer.h"
+#include "modules/renderer/shaderpasses/computepass.h"
+#include "modules/voxel/voxelmanager.h"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <deque>
+#include <vector>
+
+// mirrors NoiseSettings in noise.slangh, FastNoiseLite's OpenSimplex2 with a fractal
+struct NoiseSettings {
+    int32_t seed = 1337;
+    float frequency = 0.01f;
+    int32_t octaves = 3;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    float weightedStrength = 0.0f;
+};
+
+// mirrors TerrainSettings in terraingen.slang
+struct TerrainSettings {
+    NoiseSettings hills{1337, 0.004f, 5, 2.0f, 0.5f, 0.0f};
+    NoiseSettings mountains{7331, 0.0015f, 4, 2.0f, 0.5f, 0.0f};
+    float baseHeight = 96.0f;
+    float hillHeight = 40.0f;
+    float mountainHeight = 220.0f;
+    int32_t seaLevel = 80;
+    int32_t snowLine = 250;
+    uint32_t soilDepth = 4;
+    Voxel grass{};        // TerrainGenerator::Init picks the test world's colors for these
+    Voxel dirt{};
+    Voxel stone{};
+    Voxel sand{};
+    Voxel water{};
+    Voxel snow{};
+
+    int32_t GetMaxHeight(void) const { return static_cast<int32_t>(baseHeight + hillHeight + mountainHeight) + 1; }
+};
+
+// Generates terrain chunks on the GPU. The terraingen pass evaluates the noise for a batch of chunks into dense blocks,
+// a column of voxels per thread, which are read back a frame or two later without stalling and built into contrees on
+// worker threads (ImportDenseChunks). Chunks that came back without a solid voxel are not allocated at all. One batch is
+// in flight at a time.
+class TerrainGenerator {
+    public:
+        static constexpr uint32_t BATCH_CHUNKS = 16; // mirrors terraingen.slang, 16 MB of voxels per batch
+
+        // creates the buffers and the pass, which runs where it lands in the renderer's pass list
+        void Init(Renderer &renderer, VoxelManager &vm);
+        // queues every chunk of the columns [first, first + count) from y = 0 up to settings.GetMaxHeight()
+        void QueueColumns(glm::ivec2 first, glm::ivec2 count);
+        void Queue(glm::ivec3 chunk);
+        // once per frame: builds a batch that came back, reads back the one that ran and sends the next one
+        void Process(VoxelManager &vm);
+
+        size_t GetQueuedCount(void) const { return queue.size(); }
+        bool IsIdle(void) const { return queue.empty() && state == State::Idle; }
+
+        TerrainSettings settings{};
+    private:
+        enum class State {
+            Idle,
+            Dispatch, // sent, waiting for the pass to run
+            Download  // ran, waiting for the readback
+        };
+
+        TypedBuffer<TerrainSettings> *settingsBuffer = nullptr;
+        TypedBuffer<glm::ivec4> *chunks = nullptr;
+        TypedBuffer<uint32_t> *output = nullptr;
+        std::deque<glm::ivec3> queue{};
+        std::vector<glm::ivec3> batch{};
+        std::vector<Voxel> ready{};    // the blocks of the batch, copied out by the readback callback
+        std::vector<uint32_t> solid{}; // solid voxels per chunk of the batch
+        State state = State::Idle;
+        bool dispatched = false;       // set by the pass once it dispatched the batch
+        bool readBack = false;
+};
\ No newline at end of file
@@ -6,14 +6,34 @@
 #include "input.h"
 #include "console.h"
 #include "modules/voxel/voxelmanager.h"
+#include "modules/voxel/worldgen.h"
 
 #include "shaders/depth.h"
 #include "shaders/upscale.h"
 #include "shaders/primary.h"
+#include "shaders/clearvisibility.h"
+#include "shaders/nodedecode.h"
+#include "shaders/voxeledit.h"
 
 #include <string>
+#include <algorithm>
 #include <math.h>
+#include <cstddef>
+#include <bit>
+#include <chrono>
 
+// the shaders read nodes and chunk records as words at these offsets, see ContreeNode and Chunk in voxel.slangh
+static_assert(sizeof(ContreeNode) == 70 * sizeof(uint32_t));
+static_assert(offsetof(ContreeNode, occupancyMask) == 2 * sizeof(uint32_t));
+static_assert(offsetof(ContreeNode, child_nodes) == 4 * sizeof(uint32_t));
+static_assert(offsetof(ContreeNode, lod_voxel) == 68 * sizeof(uint32_t));
+static_assert(sizeof(Chunk) == 8 * sizeof(uint32_t));
+static_assert(sizeof(VoxelEdit) == 12 * sizeof(uint32_t));
+static_assert(sizeof(WorldHeap) == 16 * sizeof(uint32_t)); // a multiple of 16 bytes, the uniform layout pads nothing
+
+static constexpr size_t MAX_PAGE_UPLOADS = 64; // node pages made resident per frame, about 4.5 MB
+static constexpr uint32_t VISIBILITY_FRAMES = 8; // frames of ray visibility gathered per readback
+static constexpr uint32_t OVERLAY_NODES = 16384; // nodes GPU edits can split off before the CPU caught up, about 4.5 MB
 
 
 void VoxelRenderer::Init() {
@@ -40,658 +60,111 @@ void VoxelRenderer::Init() {
     fullDepth->format = SDL_GPU_TEXTUREFORMAT_R32_FLOAT;
     fullDepth->Create();
 
+    // worlds are compiled offline by WorldCompiler, next to the executable
     VoxelManager &vm = GetModule<VoxelManager>();
-    // ============================================================
-// 10x10x10 Minecraft-style test world
-// World size: 640 x 640 x 640 voxels
-// Chunk size: 64
-// ============================================================
-
-for (int x = 0; x < 10; x++)
-    for (int y = 0; y < 10; y++)
-        for (int z = 0; z < 10; z++)
-            vm.AllocateChunk(glm::ivec3(x, y, z));
-
-vm.GenerateChunkOccupancyMap();
-
-auto voxel = [](uint8_t r, uint8_t g, uint8_t b) {
-    Voxel v{};
-    v.set_r(r);
-    v.set_g(g);
-    v.set_b(b);
-    v.set_solid(true);
-    return v;
-};
-
-// ------------------------------------------------------------
-// Materials
-// ------------------------------------------------------------
-
-Voxel grass     = voxel(8, 24, 5);
-Voxel grassDark = voxel(5, 18, 4);
-Voxel dirt      = voxel(16, 10, 5);
-Voxel stone     = voxel(14, 14, 15);
-Voxel stoneDark = voxel(8, 8, 9);
-Voxel sand      = voxel(27, 23, 13);
-Voxel water     = voxel(3, 12, 28);
-
-Voxel wood      = voxel(18, 10, 4);
-Voxel woodDark  = voxel(11, 6, 3);
-Voxel leaves    = voxel(5, 20, 6);
-Voxel leaves2   = voxel(8, 27, 8);
-
-Voxel roof      = voxel(24, 5, 4);
-Voxel brick     = voxel(23, 16, 10);
-Voxel glass     = voxel(8, 20, 28);
-
-Voxel road      = voxel(13, 11, 8);
-Voxel torch     = voxel(31, 20, 4);
-
-// ------------------------------------------------------------
-// Helpers
-// ------------------------------------------------------------
-
-auto cube = [&](glm::ivec3 a, glm::ivec3 b, Voxel v) {
-    vm.FillVoxels(a, b, v);
-};
-
-auto tree = [&](int x, int y, int z, int height = 12) {
-
-    // Trunk
-    cube(
-        glm::ivec3(x - 2, y, z - 2),
-        glm::ivec3(x + 3, y + height, z + 3),
-        wood
-    );
-
-    // Lower foliage
-    cube(
-        glm::ivec3(x - 8, y + height - 5, z - 8),
-        glm::ivec3(x + 9, y + height + 3, z + 9),
-        leaves
-    );
-
-    // Upper foliage
-    cube(
-        glm::ivec3(x - 5, y + height + 1, z - 5),
-        glm::ivec3(x + 6, y + height + 8, z + 6),
-        leaves2
-    );
-
-    // Crown
-    cube(
-        glm::ivec3(x - 2, y + height + 6, z - 2),
-        glm::ivec3(x + 3, y + height + 11, z + 3),
-        leaves
-    );
-};
-
-auto house = [&](int x, int y, int z, int width, int depth) {
-
-    int wallHeight = 18;
-
-    // Foundation
-    cube(
-        glm::ivec3(x, y, z),
-        glm::ivec3(x + width, y + 3, z + depth),
-        stone
-    );
-
-    // Walls
-    cube(
-        glm::ivec3(x + 3, y + 3, z + 3),
-        glm::ivec3(x + width - 3, y + wallHeight, z + depth - 3),
-        brick
-    );
-
-    // Interior opening
-    cube(
-        glm::ivec3(x + 6, y + 6, z + 3),
-        glm::ivec3(x + width - 6, y + wallHeight - 3, z + 5),
-        wood
-    );
-
-    // Roof
-    cube(
-        glm::ivec3(x - 3, y + wallHeight, z - 3),
-        glm::ivec3(x + width + 3, y + wallHeight + 5, z + depth + 3),
-        roof
-    );
-
-    // Roof ridge
-    cube(
-        glm::ivec3(x + 4, y + wallHeight + 5, z + depth / 2 - 3),
-        glm::ivec3(x + width - 4, y + wallHeight + 8, z + depth / 2 + 3),
-        roof
-    );
-
-    // Door
-    cube(
-        glm::ivec3(x + width / 2 - 3, y + 4, z),
-        glm::ivec3(x + width / 2 + 3, y + 12, z + 4),
-        woodDark
-    );
-
-    // Windows
-    cube(
-        glm::ivec3(x + 6, y + 10, z - 1),
-        glm::ivec3(x + 15, y + 15, z + 2),
-        glass
-    );
-
-    cube(
-        glm::ivec3(x + width - 15, y + 10, z - 1),
-        glm::ivec3(x + width - 6, y + 15, z + 2),
-        glass
-    );
-
-    cube(
-        glm::ivec3(x - 1, y + 10, z + depth / 2 - 4),
-        glm::ivec3(x + 2, y + 15, z + depth / 2 + 4),
-        glass
-    );
-};
-
-auto tower = [&](int x, int y, int z) {
-
-    int width = 24;
-    int height = 70;
-
-    cube(
-        glm::ivec3(x, y, z),
-        glm::ivec3(x + width, y + height, z + width),
-        stoneDark
-    );
-
-    // Inner tower
-    cube(
-        glm::ivec3(x + 5, y + 5, z + 5),
-        glm::ivec3(x + width - 5, y + height - 5, z + width - 5),
-        stone
-    );
-
-    // Battlements
-    for (int i = 0; i < 4; i++) {
-        cube(
-            glm::ivec3(
-                x + i * 6,
-                y + height,
-                z
-            ),
-            glm::ivec3(
-                x + i * 6 + 4,
-                y + height + 8,
-                z + 6
-            ),
-            stoneDark
-        );
-
-        cube(
-            glm::ivec3(
-                x + i * 6,
-                y + height,
-                z + width - 6
-            ),
-            glm::ivec3(
-                x + i * 6 + 4,
-                y + height + 8,
-                z + width
-            ),
-            stoneDark
-        );
-    }
-
-    // Windows
-    for (int wy = 20; wy < height - 10; wy += 18) {
-        cube(
-            glm::ivec3(x + width / 2 - 3, y + wy, z - 1),
-            glm::ivec3(x + width / 2 + 3, y + wy + 8, z + 2),
-            glass
-        );
-    }
-};
-
-// ============================================================
-// TERRAIN
-// ============================================================
-
-// Large base
-cube(
-    glm::ivec3(0, 0, 0),
-    glm::ivec3(640, 30, 640),
-    stoneDark
-);
-
-// Broad rolling terrain.
-// Large cubes are used so the scene doesn't require hundreds
-// of thousands of FillVoxels calls.
-
-for (int x = 0; x < 640; x += 16) {
-    for (int z = 0; z < 640; z += 16) {
-
-        float fx = (float)x;
-        float fz = (float)z;
-
-        // Rolling terrain
-        float h =
-            65.0f
-            + sin(fx * 0.018f) * 22.0f
-            + sin(fz * 0.021f) * 18.0f
-            + sin((fx + fz) * 0.010f) * 25.0f
-            + sin(fx * 0.047f + fz * 0.031f) * 8.0f;
-
-        // Large mountain region
-        float dx = fx - 480.0f;
-        float dz = fz - 470.0f;
-        float mountainDist = sqrt(dx * dx + dz * dz);
-
-        if (mountainDist < 150.0f) {
-            float mountain =
-                (1.0f - mountainDist / 150.0f) * 130.0f;
-
-            mountain *= mountain;
-
-            h += mountain;
-        }
-
-        int height = (int)h;
-
-        // Stone body
-        cube(
-            glm::ivec3(x, 30, z),
-            glm::ivec3(x + 16, height - 6, z + 16),
-            stone
-        );
-
-        // Dirt layer
-        cube(
-            glm::ivec3(x, height - 6, z),
-            glm::ivec3(x + 16, height - 2, z + 16),
-            dirt
-        );
-
-        // Grass
-        cube(
-            glm::ivec3(x, height - 2, z),
-            glm::ivec3(x + 16, height + 1, z + 16),
-            grass
-        );
-    }
-}
-
-// ============================================================
-// LAKE
-// ============================================================
-
-cube(
-    glm::ivec3(60, 45, 380),
-    glm::ivec3(270, 49, 540),
-    water
-);
-
-// Lake shoreline
-cube(
-    glm::ivec3(48, 43, 368),
-    glm::ivec3(282, 46, 552),
-    sand
-);
-
-// Put water back on top
-cube(
-    glm::ivec3(60, 47, 380),
-    glm::ivec3(270, 51, 540),
-    water
-);
-
-// ============================================================
-// CENTRAL VILLAGE
-// ============================================================
-
-const int villageX = 210;
-const int villageZ = 180;
-const int villageY = 90;
-
-// Main road
-cube(
-    glm::ivec3(villageX - 100, villageY, villageZ + 30),
-    glm::ivec3(villageX + 110, villageY + 3, villageZ + 50),
-    road
-);
-
-cube(
-    glm::ivec3(villageX + 20, villageY, villageZ - 80),
-    glm::ivec3(villageX + 40, villageY + 3, villageZ + 110),
-    road
-);
-
-// Cross road
-cube(
-    glm::ivec3(villageX - 40, villageY, villageZ - 20),
-    glm::ivec3(villageX + 100, villageY + 3, villageZ),
-    road
-);
-
-// Houses
-house(villageX - 80, villageY + 3, villageZ - 60, 45, 40);
-house(villageX + 55, villageY + 3, villageZ - 55, 45, 40);
-house(villageX - 80, villageY + 3, villageZ + 65, 45, 40);
-house(villageX + 55, villageY + 3, villageZ + 60, 45, 40);
-
-// Small central plaza
-cube(
-    glm::ivec3(villageX - 25, villageY + 3, villageZ - 25),
-    glm::ivec3(villageX + 70, villageY + 6, villageZ + 70),
-    stone
-);
-
-// Fountain
-cube(
-    glm::ivec3(villageX + 10, villageY + 6, villageZ + 10),
-    glm::ivec3(villageX + 35, villageY + 10, villageZ + 35),
-    stoneDark
-);
-
-cube(
-    glm::ivec3(villageX + 14, villageY + 10, villageZ + 14),
-    glm::ivec3(villageX + 31, villageY + 12, villageZ + 31),
-    water
-);
-
-// ============================================================
-// CENTRAL CASTLE
-// ============================================================
-
-const int castleX = 430;
-const int castleZ = 150;
-const int castleY = 130;
-
-// Castle floor
-cube(
-    glm::ivec3(castleX - 65, castleY, castleZ - 65),
-    glm::ivec3(castleX + 65, castleY + 8, castleZ + 65),
-    stoneDark
-);
-
-// Castle walls
-cube(
-    glm::ivec3(castleX - 60, castleY + 8, castleZ - 60),
-    glm::ivec3(castleX + 60, castleY + 45, castleZ - 45),
-    stone
-);
-
-cube(
-    glm::ivec3(castleX - 60, castleY + 8, castleZ + 45),
-    glm::ivec3(castleX + 60, castleY + 45, castleZ + 60),
-    stone
-);
-
-cube(
-    glm::ivec3(castleX - 60, castleY + 8, castleZ - 60),
-    glm::ivec3(castleX - 45, castleY + 45, castleZ + 60),
-    stone
-);
-
-cube(
-    glm::ivec3(castleX + 45, castleY + 8, castleZ - 60),
-    glm::ivec3(castleX + 60, castleY + 45, castleZ + 60),
-    stone
-);
-
-// Four towers
-tower(castleX - 65, castleY, castleZ - 65);
-tower(castleX + 40, castleY, castleZ - 65);
-tower(castleX - 65, castleY, castleZ + 40);
-tower(castleX + 40, castleY, castleZ + 40);
-
-// Castle entrance
-cube(
-    glm::ivec3(castleX - 12, castleY + 8, castleZ - 70),
-    glm::ivec3(castleX + 12, castleY + 35, castleZ - 43),
-    woodDark
-);
-
-// ============================================================
-// TREES
-// ============================================================
-
-// Forest on the western side
-for (int x = 30; x < 180; x += 28) {
-    for (int z = 40; z < 300; z += 31) {
-
-        // Avoid village
-        if (x > 100 && x < 350 &&
-            z > 100 && z < 300)
-            continue;
-
-        float fx = (float)x;
-        float fz = (float)z;
-
-        int y =
-            65
-            + (int)(
-                sin(fx * 0.018f) * 22.0f
-                + sin(fz * 0.021f) * 18.0f
-                + sin((fx + fz) * 0.010f) * 25.0f
-            );
-
-        tree(x, y, z, 10 + ((x + z) % 6));
-    }
-}
-
-// Forest around lake
-for (int x = 300; x < 600; x += 35) {
-    for (int z = 330; z < 600; z += 37) {
-
-        // Keep lake open
-        if (x > 40 && x < 290 &&
-            z > 360 && z < 550)
-            continue;
-
-        float fx = (float)x;
-        float fz = (float)z;
-
-        int y =
-            65
-            + (int)(
-                sin(fx * 0.018f) * 22.0f
-                + sin(fz * 0.021f) * 18.0f
-                + sin((fx + fz) * 0.010f) * 25.0f
-            );
-
-        tree(x, y, z, 11 + ((x * 3 + z) % 7));
-    }
-}
-
-// ============================================================
-// MOUNTAIN PEAKS
-// ============================================================
-
-// Large snowy-looking stone peaks
-for (int i = 0; i < 5; i++) {
-
-    int x = 420 + i * 30;
-    int z = 430 + (i % 2) * 35;
-
-    int baseY = 150 + i * 8;
-
-    for (int r = 50; r > 5; r -= 10) {
-
-        int y = baseY + (50 - r) * 2;
-
-        cube(
-            glm::ivec3(x - r, y, z - r),
-            glm::ivec3(x + r, y + 12, z + r),
-            stone
-        );
-    }
-
-    // Peak
-    cube(
-        glm::ivec3(x - 10, baseY + 90, z - 10),
-        glm::ivec3(x + 10, baseY + 125, z + 10),
-        stone
-    );
-}
-
-// ============================================================
-// FLOATING ISLAND
-// ============================================================
-
-cube(
-    glm::ivec3(70, 250, 70),
-    glm::ivec3(150, 270, 150),
-    stone
-);
-
-cube(
-    glm::ivec3(82, 270, 82),
-    glm::ivec3(138, 278, 138),
-    dirt
-);
-
-cube(
-    glm::ivec3(82, 278, 82),
-    glm::ivec3(138, 282, 138),
-    grass
-);
-
-// Tree on floating island
-tree(110, 282, 110, 18);
-
-// Hanging underside
-for (int r = 35; r > 0; r -= 7) {
-
-    int y = 250 - (35 - r);
-
-    cube(
-        glm::ivec3(110 - r, y, 110 - r),
-        glm::ivec3(110 + r, y + 8, 110 + r),
-        stoneDark
-    );
-}
-
-// ============================================================
-// SMALL RUINS
-// ============================================================
-
-for (int i = 0; i < 7; i++) {
-
-    int x = 300 + i * 23;
-    int z = 70 + (i % 3) * 30;
-
-    cube(
-        glm::ivec3(x, 100, z),
-        glm::ivec3(x + 10, 130 + (i % 3) * 10, z + 10),
-        stoneDark
-    );
-
-    if (i % 2 == 0) {
-        cube(
-            glm::ivec3(x + 14, 100, z),
-            glm::ivec3(x + 24, 120, z + 10),
-            stone
-        );
-    }
-}
-
-// ============================================================
-// TORCHES / LIGHTS AROUND VILLAGE
-// ============================================================
-
-for (int x = villageX - 90; x <= villageX + 100; x += 30) {
-
-    cube(
-        glm::ivec3(x, villageY + 4, villageZ + 25),
-        glm::ivec3(x + 3, villageY + 15, villageZ + 28),
-        woodDark
-    );
-
-    cube(
-        glm::ivec3(x - 2, villageY + 15, villageZ + 23),
-        glm::ivec3(x + 5, villageY + 20, villageZ + 30),
-        torch
-    );
-}
-
-// ============================================================
-// BRIDGE OVER LAKE
-// ============================================================
-
-cube(
-    glm::ivec3(260, 55, 430),
-    glm::ivec3(350, 61, 450),
-    wood
-);
-
-for (int x = 260; x <= 350; x += 15) {
-
-    cube(
-        glm::ivec3(x, 50, 430),
-        glm::ivec3(x + 5, 55, 435),
-        woodDark
-    );
-
-    cube(
-        glm::ivec3(x, 50, 445),
-        glm::ivec3(x + 5, 55, 450),
-        woodDark
-    );
-}
-
-// ============================================================
-// FINAL GRASS PATCHES
-// ============================================================
-
-// Break up the perfectly flat terrain with small elevated
-// patches around the world.
-
-for (int x = 20; x < 620; x += 43) {
-    for (int z = 20; z < 620; z += 47) {
-
-        // Don't clutter major structures
-        if (x > 130 && x < 340 &&
-            z > 100 && z < 300)
-            continue;
-
-        if (x > 390 && z > 100 && z < 300)
-            continue;
-
-        cube(
-            glm::ivec3(x, 82, z),
-            glm::ivec3(x + 8, 86, z + 8),
-            grassDark
-        );
+    std::string worldPath = std::string(SDL_GetBasePath()) + "world.vxw";
+    uint64_t loadStart = SDL_GetTicksNS();
+    if (vm.LoadWorld(worldPath)) {
+        SDL_Log("Loaded %s in %.1f ms", worldPath.c_str(), (SDL_GetTicksNS() - loadStart) / 1e6);
+    } else {
+        SDL_Log("No compiled world at %s, generating the test world (run WorldCompiler to skip this)", worldPath.c_str());
+        GenerateTestWorld(vm);
+        size_t reclaimed = vm.Canonicalize();
+        SDL_Log("Canonicalize reclaimed %zu of %zu contree nodes", reclaimed, vm.contree_data.size());
     }
-}
 
-    posBuffer = renderer.CreateResource<TypedBuffer<glm::vec3>>();
-    posBuffer->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
-    posBuffer->SetSize(1);
-    posBuffer->Create();
-
-    TypedBuffer<ContreeNode> *nodes = renderer.CreateResource<TypedBuffer<ContreeNode>>();
-    nodes->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
-    nodes->SetSize(vm.contree_data.size());
-    nodes->Create();
-    nodes->Upload(vm.contree_data);
-
-    TypedBuffer<Chunk> *chunks = renderer.CreateResource<TypedBuffer<Chunk>>();
-    chunks->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
-    chunks->SetSize(vm.allocated_chunks.size());
-    chunks->Create();
-    chunks->Upload(vm.allocated_chunks);
-
-    TypedBuffer<ChunkPositionsHeader> *chunkPositionsHeader = renderer.CreateResource<TypedBuffer<ChunkPositionsHeader>>();
-    chunkPositionsHeader->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
-    chunkPositionsHeader->SetSize(1);
-    chunkPositionsHeader->Create();
-    chunkPositionsHeader->Upload((ChunkPositionsHeader*)&vm.chunk_occupancy, 1);
-
-    TypedBuffer<uint32_t> *chunkPositions = renderer.CreateResource<TypedBuffer<uint32_t>>();
-    chunkPositions->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
-    chunkPositions->SetSize(vm.chunk_occupancy.get_size());
-    chunkPositions->Create();
-    chunkPositions->Upload((uint32_t*)vm.chunk_occupancy.chunks, vm.chunk_occupancy.get_size());
+    cameraBuffer = renderer.CreateResource<TypedBuffer<RayCamera>>();
+    cameraBuffer->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    cameraBuffer->SetSize(1);
+    cameraBuffer->Create();
+
+    // nodes, chunk records, distance fields and bricks share one buffer. sized with room for what is loaded now to
+    // grow, SyncWorld places the arrays in it and fills them in
+    heap = renderer.CreateResource<HeapBuffer>();
+    heap->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE; // nodedecode writes the nodes
+    heap->SetSize(2 * (std::min(vm.contree_data.capacity() * sizeof(ContreeNode), NodeResidency::DEFAULT_BUDGET) +
+                       vm.allocated_chunks.capacity() * sizeof(Chunk) + vm.chunk_distances.capacity() + vm.brick_data.capacity() * sizeof(uint16_t)) +
+                  (vm.chunk_occupancy.get_size() + vm.chunk_pyramid.size()) * sizeof(uint32_t) +
+                  OVERLAY_NODES * sizeof(ContreeNode) + 8 * HeapBuffer::ALIGNMENT);
+    residency.Init(heap);
+    heap->Fit(overlay, OVERLAY_NODES * sizeof(ContreeNode));
+
+    nodeStream = renderer.CreateResource<TypedBuffer<uint32_t>>();
+    nodeStream->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    residency.stream.Create(nodeStream);
+
+    // pushed ahead of every pass each frame, the world passes declare it as their first uniform buffer
+    scene = renderer.CreateResource<PushConstant<WorldHeap>>();
+    scene->slot = 0;
+
+    materials = renderer.CreateResource<TypedBuffer<Material>>();
+    materials->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    materials->SetSize(vm.materials.size());
+
+    visibility = renderer.CreateResource<TypedBuffer<uint32_t>>();
+    visibility->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    visibility->SetSize(std::max<size_t>((vm.allocated_chunks.size() + 31) / 32, 1));
+
+    edits = renderer.CreateResource<TypedBuffer<VoxelEdit>>();
+    edits->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    edits->SetSize(64);
+
+    editJobs = renderer.CreateResource<TypedBuffer<uint32_t>>();
+    editJobs->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    editJobs->SetSize(256);
+
+    editState = renderer.CreateResource<TypedBuffer<uint32_t>>();
+    editState->usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    editState->SetSize(4);
+    uint32_t state[4] = {0, OVERLAY_NODES, 0, 0};
+    editState->Upload(state, 4);
+
+    SyncWorld(SIZE_MAX); // everything that fits the budget is there from the first frame
+
+    // expands the nodes SyncWorld sent into the heap, after the copy pass that may have moved or grown it
+    ComputePass *nodeDecodePass = renderer.CreateShaderPass<ComputePass>();
+    nodeDecodePass->spirv = nodedecode_spirv;
+    nodeDecodePass->spirv_size = nodedecode_spirv_sizeInBytes/4;
+    nodeDecodePass->threadcount = {64, 1, 1};
+    nodeDecodePass->readonly_storage_buffers.push_back(nodeStream);
+    nodeDecodePass->readwrite_storage_buffers.push_back(heap);
+    nodeDecodePass->dispatchFunc = [this](const ComputePass& pass) {
+        return glm::uvec3(NodeStream::JOB_NODES / pass.threadcount.x, residency.stream.TakeDispatch(), 1);
+    };
+    nodeDecodePass->Create();
+
+    // re-applies every edit the contrees do not hold yet on top of the nodes, whatever the copy and decode just put back
+    ComputePass *editPass = renderer.CreateShaderPass<ComputePass>();
+    editPass->spirv = voxeledit_spirv;
+    editPass->spirv_size = voxeledit_spirv_sizeInBytes/4;
+    editPass->threadcount = {64, 1, 1};
+    editPass->readonly_storage_buffers.push_back(edits);
+    editPass->readonly_storage_buffers.push_back(editJobs);
+    editPass->readwrite_storage_buffers.push_back(heap);
+    editPass->readwrite_storage_buffers.push_back(editState);
+    editPass->push_constants.push_back(scene);
+    editPass->dispatchFunc = [this](const ComputePass&) {
+        uint32_t groups = editDispatch;
+        editDispatch = 0;
+        return glm::uvec3(groups, 1, 1);
+    };
+    editPass->Create();
+
+    // idle until chunks are queued, see generate_terrain
+    terrain.Init(renderer, vm);
+
+    // ahead of the passes that set the bits. it only dispatches on frames that start with a readback
+    ComputePass *clearVisibilityPass = renderer.CreateShaderPass<ComputePass>();
+    clearVisibilityPass->spirv = clearvisibility_spirv;
+    clearVisibilityPass->spirv_size = clearvisibility_spirv_sizeInBytes/4;
+    clearVisibilityPass->threadcount = {64, 1, 1};
+    clearVisibilityPass->readwrite_storage_buffers.push_back(visibility);
+    clearVisibilityPass->dispatchFunc = [this](const ComputePass& pass) {
+        uint32_t groups = clearVisibility ? uint32_t((visibility->GetSize() + pass.threadcount.x - 1) / pass.threadcount.x) : 0;
+        clearVisibility = false;
+        return glm::uvec3(groups, 1, 1);
+    };
+    clearVisibilityPass->Create();
 
     ComputePass *depthPass = renderer.CreateShaderPass<ComputePass>();
     depthPass->spirv = depth_spirv;
@@ -707,11 +180,10 @@ for (int x = 20; x < 620; x += 43) {
             1
         );
     };
-    depthPass->readonly_storage_buffers.push_back(nodes);
-    depthPass->readonly_storage_buffers.push_back(chunks);
-    depthPass->readonly_storage_buffers.push_back(chunkPositionsHeader);
-    depthPass->readonly_storage_buffers.push_back(chunkPositions);
-    depthPass->readonly_storage_buffers.push_back(posBuffer);
+    depthPass->readonly_storage_buffers.push_back(heap);
+    depthPass->readonly_storage_buffers.push_back(cameraBuffer);
+    depthPass->readwrite_storage_buffers.push_back(visibility);
+    depthPass->push_constants.push_back(scene);
     depthPass->Create();
     
     ComputePass *depthUpscale = renderer.CreateShaderPass<ComputePass>();
@@ -747,11 +219,11 @@ for (int x = 20; x < 620; x += 43) {
             1
         );
     };
-    primaryPass->readonly_storage_buffers.push_back(nodes);
-    primaryPass->readonly_storage_buffers.push_back(chunks);
-    primaryPass->readonly_storage_buffers.push_back(chunkPositionsHeader);
-    primaryPass->readonly_storage_buffers.push_back(chunkPositions);
-    primaryPass->readonly_storage_buffers.push_back(posBuffer);
+    primaryPass->readonly_storage_buffers.push_back(heap);
+    primaryPass->readonly_storage_buffers.push_back(cameraBuffer);
+    primaryPass->readonly_storage_buffers.push_back(materials);
+    primaryPass->readwrite_storage_buffers.push_back(visibility);
+    primaryPass->push_constants.push_back(scene);
     primaryPass->Create();
 
 
@@ -765,6 +237,27 @@ for (int x = 20; x < 620; x += 43) {
 
     pos = {0, 0, 0};
 
+    // 0 renders every voxel, larger values stop descending earlier
+    GetModule<Console>().CreateCommand("lod_threshold", [this](float pixels){
+        lodThreshold = pixels;
+    });
+
+    // megabytes of contree nodes kept on the GPU, chunks past it are drawn from their distance fields
+    GetModule<Console>().CreateCommand("vram_budget", [this](float megabytes){
+        residency.SetBudget(size_t(megabytes * 1024 * 1024));
+    });
+
+    // encodes the trees of the first count chunks, uploads them raw and encoded and decodes them on the CPU and the GPU
+    GetModule<Console>().CreateCommand("bench_nodestream", [this](int count){
+        BenchNodeStream(count);
+    });
+
+    // noise terrain for the chunk columns [x, x + width) by [z, z + depth), generated on the GPU a batch at a time
+    GetModule<Console>().CreateCommand("generate_terrain", [this](int x, int z, int width, int depth){
+        terrain.QueueColumns({x, z}, {width, depth});
+        GetModule<Console>().Log(std::to_string(terrain.GetQueuedCount()) + " chunks queued", Console::LogLevel::Info);
+    });
+
     window.ResizedScreen.Bind(
         [this, display, halfDepth, fullDepth](glm::ivec2 size) {
             display->size = size;
@@ -804,7 +297,15 @@ void VoxelRenderer::Process() {
         pos.y -= deltaTime;
     }
 
-    posBuffer->Upload(&pos, 1);
+    RayCamera camera{pos, lodThreshold};
+    cameraBuffer->Upload(&camera, 1);
+
+    terrain.Process(GetModule<VoxelManager>());
+    SyncEdits();
+    SyncWorld(MAX_PAGE_UPLOADS);
+
+    // one readback in flight at a time, the chunks in it are kept resident ahead of nearer ones nobody looked at
+    if (!visibilityPending && ++visibilityFrames >= VISIBILITY_FRAMES) ReadVisibility();
 
     static float elapsed = 0.0f;
     static uint32_t frames = 0;
@@ -826,6 +327,323 @@ void VoxelRenderer::Process() {
     }
 }
 
+void VoxelRenderer::ReadVisibility() {
+    visibilityFrames = 0;
+    visibilityPending = true;
+    clearVisibility = true;
+    // the bits are chunk indices from the last clear on, dropped when chunks were moved to other indices since
+    uint32_t generation = visibilityGeneration;
+    visibilityGeneration = GetModule<VoxelManager>().chunk_generation;
+    visibility->DownloadAsync(visibility->GetSize(), 0, [this, generation](const uint32_t *words, size_t count) {
+        visibilityPending = false;
+        if (GetModule<VoxelManager>().chunk_generation != generation) return;
+        for (size_t i = 0; i < count; i++) {
+            for (uint32_t bits = words[i]; bits != 0; bits &= bits - 1) {
+                residency.MarkChunkVisible(static_cast<uint32_t>(i * 32 + std::countr_zero(bits)));
+            }
+        }
+    });
+}
+
+// Edits reach the screen a frame after they were queued, long before the VoxelManager replayed them into the contrees.
+// The GPU copy of the world is whatever the CPU last sent with every pending edit applied on top, again each frame, so
+// nodes the CPU sends meanwhile can not drop one. Voxels an edit splits go to overlay nodes, handed out by a counter.
+// Nodes the CPU sends again are split again, so under a steady stream of edits the counter keeps climbing; it is read
+// back and the overlay is reset once it is three quarters full, as well as once nothing is pending.
+void VoxelRenderer::SyncEdits() {
+    VoxelManager &vm = GetModule<VoxelManager>();
+
+    if (vm.pending_edits.empty()) {
+        if (!editedChunks.empty()) ResetOverlay();
+        return;
+    }
+
+    if (overlayUsed > OVERLAY_NODES && !overlayFullLogged) {
+        GetModule<Console>().Log("edit overlay full, " + std::to_string(overlayUsed - OVERLAY_NODES) + " splits wait for the replay", Console::LogLevel::Warning);
+        overlayFullLogged = true;
+    }
+    if (overlayUsed >= OVERLAY_NODES * 3 / 4) ResetOverlay();
+
+    // the chunks of every edit whose tree the edit pass can walk, bricks and empty chunks wait for the replay
+    std::vector<std::pair<uint32_t, uint32_t>> touched;
+    for (size_t i = 0; i < vm.pending_edits.size(); i++) {
+        const VoxelEdit &edit = vm.pending_edits[i];
+        glm::ivec3 first = vm.GetChunkPosition(edit.min);
+        glm::ivec3 last = vm.GetChunkPosition(edit.max);
+        for (int z = first.z; z <= last.z; z++)
+            for (int y = first.y; y <= last.y; y++)
+                for (int x = first.x; x <= last.x; x++) {
+                    uint32_t chunk = vm.GetChunkIndex({x, y, z});
+                    if (chunk >= vm.allocated_chunks.size()) continue;
+                    const Chunk &record = vm.allocated_chunks[chunk];
+                    if ((record.flags & (CHUNK_FLAG_BRICK | CHUNK_FLAG_EMPTY)) || record.contree_node.offset >= vm.contree_data.size()) continue;
+                    touched.push_back({chunk, static_cast<uint32_t>(i)});
+                }
+    }
+    std::stable_sort(touched.begin(), touched.end(), [](const auto &a, const auto &b) { return a.first < b.first; }); // edits stay in order
+    if (touched.empty()) return;
+
+    // {job count, list word, 0, 0}, {chunk, first, count, 0} per chunk, then the edit indices
+    editWords.assign(4, 0);
+    if (editedChunks.empty()) editedGeneration = vm.chunk_generation;
+    for (size_t i = 0; i < touched.size(); i++) {
+        if (i == 0 || touched[i].first != touched[i - 1].first) {
+            editWords.insert(editWords.end(), {touched[i].first, static_cast<uint32_t>(i), 0, 0});
+            editedChunks.push_back(touched[i].first);
+        }
+        editWords[editWords.size() - 2]++;
+    }
+    std::sort(editedChunks.begin(), editedChunks.end());
+    editedChunks.erase(std::unique(editedChunks.begin(), editedChunks.end()), editedChunks.end());
+    editWords[0] = static_cast<uint32_t>((editWords.size() - 4) / 4);
+    editWords[1] = static_cast<uint32_t>(editWords.size());
+    for (const auto &[chunk, edit] : touched) editWords.push_back(edit);
+
+    // uploaded whole, nothing to keep when they grow
+    std::vector<VoxelEdit> list(vm.pending_edits.begin(), vm.pending_edits.end());
+    if (list.size() > edits->GetSize()) edits->SetSize(std::max(list.size(), edits->GetSize() * 2));
+    if (editWords.size() > editJobs->GetSize()) editJobs->SetSize(std::max(editWords.size(), editJobs->GetSize() * 2));
+    edits->Upload(list);
+    editJobs->Upload(editWords);
+    editDispatch = editWords[0];
+
+    // the copy runs behind this frame's uploads, a reset staged above is already in what it reads
+    if (!overlayPending) {
+        overlayPending = true;
+        editState->DownloadAsync(1, 0, [this, resets = overlayResets](const uint32_t *words, size_t) {
+            overlayPending = false;
+            if (resets == overlayResets) overlayUsed = words[0];
+        });
+    }
+}
+
+// Sends every chunk edited since the last reset again, which drops the overlay pointers from their nodes, and restarts
+// the counter. The edit pass splits whatever is still pending into fresh overlay nodes on the next frame.
+void VoxelRenderer::ResetOverlay() {
+    VoxelManager &vm = GetModule<VoxelManager>();
+    if (editedGeneration != vm.chunk_generation) {
+        // chunks moved to other indices meanwhile, the list can't be trusted
+        for (size_t chunk = 0; chunk < vm.allocated_chunks.size(); chunk++) vm.MarkChunkUpload(static_cast<uint32_t>(chunk));
+    } else {
+        for (uint32_t chunk : editedChunks) vm.MarkChunkUpload(chunk);
+    }
+    editedChunks.clear();
+    editedGeneration = vm.chunk_generation;
+    uint32_t state[4] = {0, OVERLAY_NODES, 0, 0};
+    editState->Upload(state, 4);
+    overlayUsed = 0;
+    overlayResets++;
+    overlayFullLogged = false;
+}
+
+// what the shaders read of a node, NodeStream leaves the rest out
+static bool SameForRays(const ContreeNode &a, const ContreeNode &b) {
+    if (a.occupancyMask != b.occupancyMask || (a.isVoxelMask & a.occupancyMask) != (b.isVoxelMask & b.occupancyMask) || a.lod_voxel != b.lod_voxel) return false;
+    for (uint64_t bits = a.occupancyMask; bits != 0; bits &= bits - 1) {
+        int child = std::countr_zero(bits);
+        if (a.voxel_data[child] != b.voxel_data[child]) return false;
+    }
+    return true;
+}
+
+void VoxelRenderer::BenchNodeStream(int count) {
+    VoxelManager &vm = GetModule<VoxelManager>();
+    Console &console = GetModule<Console>();
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+    // the nodes of every chunk's tree, in runs of consecutive indices
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    std::vector<uint32_t> tree;
+    std::vector<uint32_t> stack;
+    int chunks = 0;
+    for (const Chunk &chunk : vm.allocated_chunks) {
+        if (chunks >= count) break;
+        if (chunk.contree_node.offset >= vm.contree_data.size() || (chunk.flags & CHUNK_FLAG_BRICK)) continue;
+        chunks++;
+        tree.clear();
+        stack.push_back(chunk.contree_node.offset);
+        while (!stack.empty()) {
+            uint32_t node = stack.back();
+            stack.pop_back();
+            tree.push_back(node);
+            const ContreeNode &contree = vm.contree_data[node];
+            for (uint64_t pointers = ~contree.isVoxelMask & contree.occupancyMask; pointers != 0; pointers &= pointers - 1) {
+                uint32_t child = contree.child_nodes[std::countr_zero(pointers)].offset;
+                if (child < vm.contree_data.size()) stack.push_back(child);
+            }
+        }
+        std::sort(tree.begin(), tree.end());
+        tree.erase(std::unique(tree.begin(), tree.end()), tree.end());
+        for (uint32_t node : tree) {
+            if (!runs.empty() && runs.back().first + runs.back().second == node) runs.back().second++;
+            else runs.push_back({node, 1});
+        }
+    }
+    if (chunks == 0) {
+        console.Log("no contree chunks to bench", Console::LogLevel::Warning);
+        return;
+    }
+
+    std::vector<ContreeNode> raw;
+    for (const auto &[first, length] : runs) raw.insert(raw.end(), vm.contree_data.begin() + first, vm.contree_data.begin() + first + length);
+
+    TypedBuffer<uint32_t> streamBuffer(device);
+    streamBuffer.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    TypedBuffer<uint32_t> output(device);
+    output.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE;
+    output.SetSize(raw.size() * sizeof(ContreeNode) / sizeof(uint32_t));
+    NodeStream stream;
+    stream.Create(&streamBuffer);
+
+    Clock::time_point encodeStart = Clock::now();
+    size_t placed = 0;
+    for (const auto &[first, length] : runs) {
+        stream.Add(vm.contree_data.data() + first, first, length, placed * sizeof(ContreeNode));
+        placed += length;
+    }
+    size_t encoded = stream.GetEncodedBytes() + stream.GetNodeCount() * sizeof(uint32_t);
+    Clock::time_point encodeEnd = Clock::now();
+
+    // the CPU twin of the decode pass, on the same bytes
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> starts(raw.size());
+    placed = 0;
+    for (const auto &[first, length] : runs) {
+        for (uint32_t i = 0; i < length; i++) {
+            starts[placed++] = bytes.size();
+            NodeStream::EncodeNode(vm.contree_data[first + i], first + i, bytes);
+        }
+    }
+    std::vector<ContreeNode> decoded(raw.size(), ContreeNode{});
+    Clock::time_point decodeStart = Clock::now();
+    placed = 0;
+    for (const auto &[first, length] : runs) {
+        for (uint32_t i = 0; i < length; i++, placed++) NodeStream::DecodeNode(bytes.data() + starts[placed], first + i, decoded[placed]);
+    }
+    Clock::time_point decodeEnd = Clock::now();
+
+    // host to device, each timed until the GPU is done with it
+    TypedBuffer<ContreeNode> rawBuffer(device);
+    rawBuffer.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    rawBuffer.SetSize(raw.size());
+    SDL_WaitForGPUIdle(device);
+    Clock::time_point rawStart = Clock::now();
+    rawBuffer.Upload(raw);
+    SDL_WaitForGPUIdle(device);
+    Clock::time_point streamStart = Clock::now();
+    stream.Submit();
+    SDL_WaitForGPUIdle(device);
+    Clock::time_point streamEnd = Clock::now();
+
+    ComputePass decode(device);
+    decode.spirv = nodedecode_spirv;
+    decode.spirv_size = nodedecode_spirv_sizeInBytes/4;
+    decode.threadcount = {64, 1, 1};
+    decode.readonly_storage_buffers.push_back(&streamBuffer);
+    decode.readwrite_storage_buffers.push_back(&output);
+    decode.dispatchFunc = [&stream](const ComputePass& pass) {
+        return glm::uvec3(NodeStream::JOB_NODES / pass.threadcount.x, stream.TakeDispatch(), 1);
+    };
+    decode.Create();
+
+    SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(device);
+    decode.Execute(cmd);
+    Clock::time_point gpuStart = Clock::now();
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    SDL_WaitForGPUFences(device, true, &fence, 1);
+    Clock::time_point gpuEnd = Clock::now();
+    SDL_ReleaseGPUFence(device, fence);
+    decode.Destroy();
+
+    std::vector<ContreeNode> gpu(raw.size(), ContreeNode{});
+    output.Download(gpu.data(), 0, 0, gpu.size() * sizeof(ContreeNode));
+    size_t differ = 0;
+    for (size_t i = 0; i < raw.size(); i++) differ += !SameForRays(raw[i], decoded[i]) || !SameForRays(raw[i], gpu[i]);
+
+    double perChunk = 1000.0 / chunks; // ms in total to us per chunk
+    size_t rawBytes = raw.size() * sizeof(ContreeNode);
+    console.Log(std::to_string(chunks) + " chunks, " + std::to_string(raw.size()) + " nodes, " +
+        std::to_string(rawBytes / 1024.0 / chunks) + " KB raw and " + std::to_string(encoded / 1024.0 / chunks) + " KB encoded per chunk (" +
+        std::to_string(double(rawBytes) / encoded) + "x)", Console::LogLevel::Info);
+    console.Log("per chunk: encode " + std::to_string(ms(encodeStart, encodeEnd) * perChunk) + "us, CPU decode " + std::to_string(ms(decodeStart, decodeEnd) * perChunk) +
+        "us, raw upload " + std::to_string(ms(rawStart, streamStart) * perChunk) + "us, encoded upload " + std::to_string(ms(streamStart, streamEnd) * perChunk) +
+        "us, GPU decode " + std::to_string(ms(gpuStart, gpuEnd) * perChunk) + "us" + (differ == 0 ? "" : " (" + std::to_string(differ) + " nodes MISMATCH)"), Console::LogLevel::Info);
+}
+
+// Copies the element spans of data marked in dirty into the region. A region the data outgrew moves to a larger one
+// first, at least twice its size and no less than the capacity of the CPU side, so it moves as rarely as the vector
+// reallocates. Returns whether the region moved.
+bool VoxelRenderer::UploadRegion(HeapRegion &region, const void *data, size_t count, size_t capacity, size_t elementSize, DirtyRanges &dirty, size_t gap) {
+    bool moved = false;
+    if (count * elementSize > region.capacity || region.capacity == 0) moved = heap->Fit(region, std::max(capacity, count) * elementSize);
+
+    std::vector<DirtyRanges::Span> spans = dirty.Take(count, gap);
+    std::vector<BufferRange> ranges(spans.size());
+    for (size_t i = 0; i < spans.size(); i++) {
+        ranges[i] = {spans[i].begin * elementSize, (spans[i].end - spans[i].begin) * elementSize};
+    }
+    heap->Upload(data, ranges, region.offset);
+    region.size = count * elementSize;
+    return moved;
+}
+
+void VoxelRenderer::SyncWorld(size_t maxPageUploads) {
+    VoxelManager &vm = GetModule<VoxelManager>();
+
+    // short gaps are copied along, a few clean nodes cost less than another copy command
+    residency.Sync(vm, pos, maxPageUploads);
+    UploadRegion(chunks, vm.allocated_chunks.data(), vm.allocated_chunks.size(), vm.allocated_chunks.capacity(), sizeof(Chunk), vm.upload_chunks, 4);
+    UploadRegion(chunkDistances, vm.chunk_distances.data(), vm.chunk_distances.size() / sizeof(uint32_t), vm.chunk_distances.capacity() / sizeof(uint32_t), sizeof(uint32_t), vm.upload_distances, 16);
+    UploadRegion(bricks, vm.brick_data.data(), vm.brick_data.size() / 2, vm.brick_data.capacity() / 2, sizeof(uint32_t), vm.upload_bricks, CHUNK_WIDTH / 2);
+
+    residency.stream.Submit();
+
+    // the directory and the pyramid are rebuilt together, uploaded whole. nothing to carry over when the region moves
+    if (vm.upload_directory) {
+        size_t cells = vm.chunk_occupancy.chunks ? vm.chunk_occupancy.get_size() : 0;
+        size_t bytes = (cells + vm.chunk_pyramid.size()) * sizeof(uint32_t);
+        directory.size = 0;
+        heap->Fit(directory, std::max(bytes, sizeof(uint32_t)));
+        if (cells > 0) heap->Upload((void*)vm.chunk_occupancy.chunks, 0, directory.offset, cells * sizeof(uint32_t));
+        if (!vm.chunk_pyramid.empty()) heap->Upload(vm.chunk_pyramid.data(), 0, directory.offset + cells * sizeof(uint32_t), vm.chunk_pyramid.size() * sizeof(uint32_t));
+        directory.size = bytes;
+        vm.upload_directory = false;
+    }
+
+    // pushed with this frame's passes, so it always matches where the copies above put the arrays
+    WorldHeap &layout = scene->value;
+    layout.nodes = static_cast<uint32_t>(residency.slots.offset / sizeof(uint32_t));
+    layout.pageTable = static_cast<uint32_t>(residency.table.offset / sizeof(uint32_t));
+    layout.chunks = static_cast<uint32_t>(chunks.offset / sizeof(uint32_t));
+    layout.distances = static_cast<uint32_t>(chunkDistances.offset / sizeof(uint32_t));
+    layout.bricks = static_cast<uint32_t>(bricks.offset / sizeof(uint32_t));
+    layout.chunkLods = static_cast<uint32_t>(residency.lods.offset / sizeof(uint32_t));
+    layout.overlay = static_cast<uint32_t>(overlay.offset / sizeof(uint32_t));
+    layout.directory = static_cast<uint32_t>(directory.offset / sizeof(uint32_t));
+    layout.regionX = vm.chunk_occupancy.position.x;
+    layout.regionY = vm.chunk_occupancy.position.y;
+    layout.regionZ = vm.chunk_occupancy.position.z;
+    layout.sizeX = vm.chunk_occupancy.chunks ? vm.chunk_occupancy.size.x : 0;
+    layout.sizeY = vm.chunk_occupancy.chunks ? vm.chunk_occupancy.size.y : 0;
+    layout.sizeZ = vm.chunk_occupancy.chunks ? vm.chunk_occupancy.size.z : 0;
+    layout.pyramidLevels = vm.chunk_occupancy.pyramid_levels;
+
+    // a new buffer starts out with whatever was in its memory, it is cleared before the next passes
+    size_t visibilityWords = (vm.allocated_chunks.size() + 31) / 32;
+    if (visibilityWords > visibility->GetSize()) {
+        visibility->SetSize(std::max(visibilityWords, visibility->GetSize() * 2));
+        clearVisibility = true;
+    }
+
+    // materials are only ever appended
+    if (vm.materials.size() != uploadedMaterials) {
+        if (vm.materials.size() > materials->GetSize()) materials->Grow(vm.materials.capacity());
+        materials->Upload(vm.materials);
+        uploadedMaterials = vm.materials.size();
+    }
+}
+
 void VoxelRenderer::Shutdown() {
     
-}
+}
\ No newline at end of file
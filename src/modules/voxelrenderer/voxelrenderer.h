@@ -3,7 +3,42 @@
 #include "engine.h"
 #include "modules/renderer/renderer.h"
 #include "modules/renderer/resources/buffer.h"
+#include "modules/renderer/resources/heapbuffer.h"
+#include "modules/renderer/resources/pushconstant.h"
+#include "modules/voxel/voxel.h"
+#include "modules/voxel/voxeledit.h"
+#include "dirtyranges/dirtyranges.hpp"
+#include "noderesidency.h"
+#include "terraingenerator.h"
 #include "glm/vec3.hpp"
+
+// mirrors Camera in raytrace.slangh
+struct RayCamera {
+    glm::vec3 position{};
+    float lod_threshold = 1.0f; // pixels, rays stop at a node's lod voxel once its cells are smaller than this
+};
+
+// mirrors WorldHeap in voxel.slangh, the scene descriptor the world passes get as uniform data: word offsets of the
+// world arrays in the heap buffer and the bounds of the chunk directory
+struct WorldHeap {
+    uint32_t nodes = 0;     // the resident page slots
+    uint32_t pageTable = 0;
+    uint32_t chunks = 0;
+    uint32_t distances = 0;
+    uint32_t bricks = 0;
+    uint32_t chunkLods = 0;
+    uint32_t overlay = 0;   // nodes allocated by GPU edits
+    uint32_t directory = 0; // the chunk directory, the chunk pyramid follows
+    int32_t regionX = 0;
+    int32_t regionY = 0;
+    int32_t regionZ = 0;
+    uint32_t sizeX = 0;
+    uint32_t sizeY = 0;
+    uint32_t sizeZ = 0;
+    uint32_t pyramidLevels = 0;
+    uint32_t pad = 0;
+};
+
 class VoxelRenderer : public EngineModule {
     public:
         using EngineModule::EngineModule;
@@ -11,7 +46,47 @@ class VoxelRenderer : public EngineModule {
         void Process(void) override;
         void Shutdown(void) override;
     private:
+        // copies what the VoxelManager marked as changed since the last call, loading at most maxPageUploads node pages
+        void SyncWorld(size_t maxPageUploads);
+        bool UploadRegion(HeapRegion &region, const void *data, size_t count, size_t capacity, size_t elementSize, DirtyRanges &dirty, size_t gap);
+        // reads back the chunks the rays reached since the last clear and has the field cleared after the copy
+        void ReadVisibility(void);
+        // uploads the edits the VoxelManager has not replayed yet for the edit pass, resets the overlay once it did or
+        // once the overlay fills up
+        void SyncEdits(void);
+        void ResetOverlay(void);
+        void BenchNodeStream(int count);
+
         SDL_GPUDevice *device = nullptr;
-        TypedBuffer<glm::vec3> *posBuffer = nullptr;
+        TypedBuffer<RayCamera> *cameraBuffer = nullptr;
+        HeapBuffer *heap = nullptr;
+        PushConstant<WorldHeap> *scene = nullptr; // rebuilt by SyncWorld every frame
+        TypedBuffer<uint32_t> *nodeStream = nullptr; // encoded nodes for the decode pass, see NodeStream
+        NodeResidency residency{};
+        TerrainGenerator terrain{};
+        HeapRegion chunks{};
+        HeapRegion chunkDistances{};
+        HeapRegion bricks{};
+        HeapRegion overlay{};
+        HeapRegion directory{};
+        TypedBuffer<Material> *materials = nullptr;
+        TypedBuffer<uint32_t> *visibility = nullptr; // a bit per chunk, set by the depth and primary passes
+        bool clearVisibility = true;   // the clear pass runs on the next frame, right behind the readback copy
+        bool visibilityPending = false;
+        uint32_t visibilityFrames = 0;
+        uint32_t visibilityGeneration = 0; // VoxelManager::chunk_generation when the field was last cleared
+        TypedBuffer<VoxelEdit> *edits = nullptr;
+        TypedBuffer<uint32_t> *editJobs = nullptr;  // a job per edited chunk, see voxeledit.slang
+        TypedBuffer<uint32_t> *editState = nullptr; // {overlay nodes allocated, overlay capacity, 0, 0}
+        uint32_t editDispatch = 0;
+        std::vector<uint32_t> editedChunks{};       // their nodes go up again once the overlay is reset
+        uint32_t editedGeneration = 0;              // VoxelManager::chunk_generation the indices of editedChunks belong to
+        uint32_t overlayUsed = 0;                   // the allocation counter as last read back, past capacity once splits were dropped
+        uint32_t overlayResets = 0;                 // readbacks from before the last reset are ignored
+        bool overlayPending = false;
+        bool overlayFullLogged = false;
+        std::vector<uint32_t> editWords{};
+        size_t uploadedMaterials = 0;
         glm::vec3 pos{};
+        float lodThreshold = 1.0f;
 };
\ No newline at end of file
@@ -0,0 +1,257 @@
+// WorldCompiler: runs the world generators and importers headlessly and writes a compiled world file for the game.
+//
+//   WorldCompiler <output.vxw> [--empty] [--dedup] [--report <file>]
+//                 [--vox <file> <x> <y> <z>]... [--heightmap <file> <x> <y> <z>]...
+//
+// --empty skips the built in test world, --dedup stores identical subtrees once (smaller files, the game copies them
+// apart again on load so edits stay local) and --report writes the statistics to a file as well as stdout.
+
+#include "modules/voxel/voxelmanager.h"
+#include "modules/voxel/voxelimport.h"
+#include "modules/voxel/worldfile.h"
+#include "modules/voxel/worldgen.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+
+static constexpr size_t NODE_CHILD_COUNT = CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH * CONTREE_NODE_WIDTH;
+
+struct Import {
+    bool heightmap = false;
+    std::string path;
+    glm::ivec3 position{};
+};
+
+static uint64_t HashNode(const ContreeNode &node) {
+    uint64_t hash = 0xcbf29ce484222325ull ^ node.isVoxelMask;
+    for (size_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        hash = (hash ^ node.voxel_data[i].data) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool SameNode(const ContreeNode &a, const ContreeNode &b) {
+    return a.isVoxelMask == b.isVoxelMask && std::memcmp(a.voxel_data, b.voxel_data, sizeof(a.voxel_data)) == 0;
+}
+
+// Hash conses the trees bottom up: children are replaced by their canonical copy before the parent is looked up, so
+// identical subtrees compare equal byte for byte. Afterwards nodes may have several parents.
+struct Deduplicator {
+    const std::vector<ContreeNode> &source;
+    std::vector<ContreeNode> unique{};
+    std::unordered_multimap<uint64_t, uint32_t> lookup{};
+
+    uint32_t Canonical(uint32_t index) {
+        ContreeNode node = source[index];
+        if (node.isVoxelMask != CONTREE_VOXEL_MASK_FULL) {
+            for (size_t i = 0; i < NODE_CHILD_COUNT; i++) {
+                if (!node.IsVoxel(i)) node.child_nodes[i] = Canonical(node.child_nodes[i].offset);
+            }
+        }
+
+        uint64_t hash = HashNode(node);
+        auto [first, last] = lookup.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            if (SameNode(unique[it->second], node)) return it->second;
+        }
+        unique.push_back(node);
+        lookup.emplace(hash, static_cast<uint32_t>(unique.size() - 1));
+        return static_cast<uint32_t>(unique.size() - 1);
+    }
+};
+
+struct DepthStats {
+    size_t nodes = 0;
+    size_t pointer_slots = 0;
+    size_t solid_slots = 0;
+    size_t air_slots = 0;
+};
+
+// per depth totals over unique nodes
+static void CountNode(const std::vector<ContreeNode> &nodes, uint32_t index, uint32_t depth, std::vector<bool> &seen, std::vector<DepthStats> &depths) {
+    if (seen[index]) return;
+    seen[index] = true;
+
+    const ContreeNode &node = nodes[index];
+    DepthStats &stats = depths[depth];
+    stats.nodes++;
+    for (size_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        if (!((node.isVoxelMask >> i) & 1)) {
+            stats.pointer_slots++;
+            CountNode(nodes, node.child_nodes[i].offset, depth + 1, seen, depths);
+        } else if (node.voxel_data[i].solid()) {
+            stats.solid_slots++;
+        } else {
+            stats.air_slots++;
+        }
+    }
+}
+
+// nodes in the tree below index, counting shared subtrees every time they are referenced
+static size_t TreeSize(const std::vector<ContreeNode> &nodes, uint32_t index) {
+    const ContreeNode &node = nodes[index];
+    size_t size = 1;
+    if (node.isVoxelMask == CONTREE_VOXEL_MASK_FULL) return size;
+    for (size_t i = 0; i < NODE_CHILD_COUNT; i++) {
+        if (!((node.isVoxelMask >> i) & 1)) size += TreeSize(nodes, node.child_nodes[i].offset);
+    }
+    return size;
+}
+
+static std::string Report(const std::string &path, const std::vector<ContreeNode> &nodes, const std::vector<Chunk> &chunks, size_t brick_voxels, size_t nodes_before_dedup, double seconds) {
+    std::vector<DepthStats> depths(CONTREE_MAX_DEPTH);
+    std::vector<bool> seen(nodes.size(), false);
+    std::vector<size_t> chunk_nodes;
+    size_t uniform_chunks = 0;
+    size_t empty_chunks = 0;
+    size_t bricked_chunks = 0;
+    for (const Chunk &chunk : chunks) {
+        if (chunk.flags & CHUNK_FLAG_EMPTY) empty_chunks++;
+        if (chunk.flags & CHUNK_FLAG_BRICK) bricked_chunks++;
+        CountNode(nodes, chunk.contree_node.offset, 0, seen, depths);
+        chunk_nodes.push_back(TreeSize(nodes, chunk.contree_node.offset));
+        ContreeNode root = nodes[chunk.contree_node.offset];
+        if (root.IsUniform()) uniform_chunks++;
+    }
+    std::sort(chunk_nodes.begin(), chunk_nodes.end());
+
+    auto megabytes = [](size_t bytes) { return std::to_string(bytes / (1024.0 * 1024.0)) + " MB"; };
+    auto percent = [](size_t part, size_t whole) { return whole ? std::to_string(100.0 * part / whole) + "%" : std::string("-"); };
+
+    std::stringstream ss;
+    ss << path << "\n";
+    ss << "  compile time      " << seconds << " s\n";
+    ss << "  file size         " << megabytes(std::filesystem::file_size(path)) << "\n";
+    ss << "  chunks            " << chunks.size() << " (" << uniform_chunks << " uniform, " << percent(uniform_chunks, chunks.size()) << ", " << empty_chunks << " empty)\n";
+    ss << "  nodes             " << nodes.size() << " (" << megabytes(nodes.size() * sizeof(ContreeNode)) << ")\n";
+    ss << "  bricks            " << bricked_chunks << " chunks (" << megabytes(brick_voxels * sizeof(uint16_t)) << ")\n";
+    if (nodes_before_dedup != nodes.size()) {
+        ss << "  deduplicated      " << nodes_before_dedup - nodes.size() << " nodes removed, " << percent(nodes_before_dedup - nodes.size(), nodes_before_dedup) << "\n";
+    }
+    for (uint32_t depth = 0; depth < CONTREE_MAX_DEPTH; depth++) {
+        const DepthStats &stats = depths[depth];
+        size_t slots = stats.nodes * NODE_CHILD_COUNT;
+        ss << "  depth " << depth << "           " << stats.nodes << " nodes, uniform slots " << percent(slots - stats.pointer_slots, slots)
+           << " (solid " << percent(stats.solid_slots, slots) << ", air " << percent(stats.air_slots, slots) << ")\n";
+    }
+    if (!chunk_nodes.empty()) {
+        size_t total = 0;
+        for (size_t count : chunk_nodes) total += count;
+        ss << "  bytes per chunk   min " << chunk_nodes.front() * sizeof(ContreeNode)
+           << ", median " << chunk_nodes[chunk_nodes.size() / 2] * sizeof(ContreeNode)
+           << ", mean " << total * sizeof(ContreeNode) / chunk_nodes.size()
+           << ", max " << chunk_nodes.back() * sizeof(ContreeNode) << " (before sharing)\n";
+    }
+    return ss.str();
+}
+
+static void PrintUsage(void) {
+    std::printf("usage: WorldCompiler <output.vxw> [--empty] [--dedup] [--report <file>] [--vox <file> <x> <y> <z>]... [--heightmap <file> <x> <y> <z>]...\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string output = argv[1];
+    std::string report_path;
+    bool empty = false;
+    bool dedup = false;
+    std::vector<Import> imports;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--empty") {
+            empty = true;
+        } else if (arg == "--dedup") {
+            dedup = true;
+        } else if (arg == "--report" && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if ((arg == "--vox" || arg == "--heightmap") && i + 4 < argc) {
+            Import import;
+            import.heightmap = arg == "--heightmap";
+            import.path = argv[i + 1];
+            import.position = glm::ivec3(std::atoi(argv[i + 2]), std::atoi(argv[i + 3]), std::atoi(argv[i + 4]));
+            imports.push_back(import);
+            i += 4;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    VoxelManager vm(nullptr);
+    vm.Init();
+
+    if (!empty) GenerateTestWorld(vm);
+
+    for (const Import &import : imports) {
+        bool ok;
+        if (import.heightmap) {
+            HeightmapImport settings;
+            settings.surface.set_rgb(8, 24, 5);
+            settings.surface.set_solid(true);
+            settings.soil.set_rgb(16, 10, 5);
+            settings.soil.set_solid(true);
+            settings.rock.set_rgb(14, 14, 15);
+            settings.rock.set_solid(true);
+            ok = ImportHeightmap(vm, import.path, import.position, settings);
+        } else {
+            ok = ImportVox(vm, import.path, import.position);
+        }
+        if (!ok) {
+            std::fprintf(stderr, "could not import %s\n", import.path.c_str());
+            return 1;
+        }
+    }
+
+    if (vm.allocated_chunks.empty()) {
+        std::fprintf(stderr, "nothing to compile\n");
+        return 1;
+    }
+
+    // every chunk may hold leftovers from the fills, fold them all
+    for (const Chunk &chunk : vm.allocated_chunks) {
+        glm::ivec3 origin = chunk.position * glm::ivec3(CHUNK_WIDTH);
+        vm.MarkDirty(origin, origin);
+    }
+    vm.Canonicalize();
+    vm.CompactNodes();
+
+    size_t nodes_before_dedup = vm.contree_data.size();
+    uint32_t flags = 0;
+    if (dedup) {
+        Deduplicator deduplicator{vm.contree_data};
+        for (Chunk &chunk : vm.allocated_chunks) chunk.contree_node = deduplicator.Canonical(chunk.contree_node.offset);
+        vm.contree_data = std::move(deduplicator.unique);
+        ReorderNodes(vm.contree_data, vm.allocated_chunks);
+        flags |= WORLD_FLAG_SHARED_NODES;
+    }
+
+    ChunkPositionsHeader directory{vm.chunk_occupancy.position, vm.chunk_occupancy.size};
+    std::span<const uint32_t> directory_chunks(reinterpret_cast<const uint32_t*>(vm.chunk_occupancy.chunks), vm.chunk_occupancy.get_size());
+    if (!WriteWorldFile(output, flags, vm.contree_data, vm.allocated_chunks, vm.materials, directory, directory_chunks, vm.brick_data)) {
+        std::fprintf(stderr, "could not write %s\n", output.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::string report = Report(output, vm.contree_data, vm.allocated_chunks, vm.brick_data.size(), nodes_before_dedup, seconds);
+    std::fputs(report.c_str(), stdout);
+    if (!report_path.empty()) std::ofstream(report_path) << report;
+
+    vm.Shutdown();
+    return 0;
+}
\ No newline at end of file